@@ -0,0 +1,291 @@
+#pragma once
+
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "TacoLite.h"
+
+/*
+ * COROUTINE QUERIES
+ * sqlite3_step runs on the threads of an AsyncPool, the awaiting coroutine is
+ * resumed once per operation, or once per batch of rows:
+ *
+ *     co_await pool.Execute(connection, "insert into Users values (?)", name);
+ *
+ *     AsyncQuery<User> users = pool.Select<User>(connection, "select Id, Name from Users");
+ *     while(auto batch = co_await users.Next())
+ *     {
+ *         for(User & user : *batch) { ... }
+ *     }
+ *
+ * A connection must not be used by two operations at the same time, nor by
+ * its own thread while an operation on it is running.
+ * */
+
+class AsyncPool
+{
+    public:
+        // where coroutines continue once their work is done, on the pool thread by default
+        using Resumer = std::function<void(std::coroutine_handle<>)>;
+
+    private:
+        std::mutex m_mutex;
+        std::condition_variable m_posted;
+        std::deque<std::function<void()>> m_work;
+        bool m_stopping = false;
+        Resumer m_resume;
+        std::vector<std::thread> m_threads;
+
+        void Run() noexcept
+        {
+            for(;;)
+            {
+                std::function<void()> work;
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_posted.wait(lock, [this] { return m_stopping || !m_work.empty(); });
+
+                    if(m_work.empty()) return;
+
+                    work = std::move(m_work.front());
+                    m_work.pop_front();
+                }
+                work();
+            }
+        }
+
+    public:
+        explicit AsyncPool(unsigned const threads = std::thread::hardware_concurrency(), Resumer resume = Resumer()) :
+        m_resume{std::move(resume)}
+        {
+            if(!m_resume)
+            {
+                m_resume = [](std::coroutine_handle<> const coroutine) { coroutine.resume(); };
+            }
+            for(unsigned index = 0; index != (threads ? threads : 1); ++index)
+            {
+                m_threads.emplace_back([this] { Run(); });
+            }
+        }
+
+        AsyncPool(AsyncPool const &) = delete;
+        AsyncPool & operator=(AsyncPool const &) = delete;
+
+        // work already posted still runs
+        ~AsyncPool() noexcept
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stopping = true;
+            }
+            m_posted.notify_all();
+            for(std::thread & thread : m_threads)
+            {
+                thread.join();
+            }
+        }
+
+        void Post(std::function<void()> work)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_work.push_back(std::move(work));
+            }
+            m_posted.notify_one();
+        }
+
+        void Resume(std::coroutine_handle<> const coroutine)
+        {
+            m_resume(coroutine);
+        }
+
+        // any work on the connection: R result = co_await pool.Run(connection, work)
+        template <typename F>
+        auto Run(Connection const & connection, F work);
+
+        // the asynchronous version of Execute, values are copied until the statement runs
+        template <typename ... Values>
+        auto Execute(Connection const & connection, char const * const text, Values && ... values);
+
+        // rows decoded through RowTraits<T> in batches of the given size
+        template <typename T, typename ... Values>
+        auto Select(Connection const & connection, char const * const text, Values && ... values);
+
+        template <typename T, typename ... Values>
+        auto SelectBatches(Connection const & connection, std::size_t batch, char const * const text,
+                Values && ... values);
+};
+
+// awaiting work done by the pool, the coroutine is suspended meanwhile
+template <typename R>
+class AsyncOperation
+{
+        using Result = std::conditional_t<std::is_void_v<R>, bool, R>;
+
+        AsyncPool * m_pool = nullptr;
+        std::function<R()> m_work;
+        std::optional<Result> m_result;
+        std::exception_ptr m_error;
+
+    public:
+        AsyncOperation(AsyncPool & pool, std::function<R()> work) :
+        m_pool{&pool},
+        m_work{std::move(work)}
+        {}
+
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> const coroutine)
+        {
+            // the operation lives in the coroutine frame until it is resumed
+            m_pool->Post([this, coroutine]
+            {
+                try
+                {
+                    if constexpr (std::is_void_v<R>)
+                    {
+                        m_work();
+                        m_result = true;
+                    }
+                    else
+                    {
+                        m_result = m_work();
+                    }
+                }
+                catch(...)
+                {
+                    m_error = std::current_exception();
+                }
+                m_pool->Resume(coroutine);
+            });
+        }
+
+        R await_resume()
+        {
+            if(m_error)
+            {
+                std::rethrow_exception(m_error);
+            }
+            if constexpr (!std::is_void_v<R>)
+            {
+                return std::move(*m_result);
+            }
+        }
+};
+
+// rows of a query, handed to the coroutine a batch at a time,
+// T must own its values (std::string, not std::string_view)
+template <typename T>
+class AsyncQuery
+{
+        AsyncPool * m_pool = nullptr;
+        Connection const * m_connection = nullptr;
+        std::string m_text;
+        // binds the stored values once the statement is prepared
+        std::function<void(Statement const &)> m_bind;
+        std::size_t m_batch = 0;
+        Statement m_statement;
+        bool m_done = false;
+
+        std::optional<std::vector<T>> Fetch()
+        {
+            if(m_done) return std::nullopt;
+
+            if(!m_statement)
+            {
+                m_statement.Prepare(*m_connection, m_text.c_str());
+                m_bind(m_statement);
+                CheckColumns<T>(m_statement.GetAbi());
+            }
+
+            std::vector<T> rows;
+            rows.reserve(m_batch);
+
+            while(rows.size() != m_batch)
+            {
+                if(!m_statement.Step())
+                {
+                    m_done = true;
+                    break;
+                }
+                rows.push_back(m_statement.template Read<T>());
+            }
+
+            if(rows.empty()) return std::nullopt;
+            return rows;
+        }
+
+    public:
+        AsyncQuery(AsyncPool & pool, Connection const & connection, std::string text,
+                std::function<void(Statement const &)> bind, std::size_t const batch) :
+                m_pool{&pool},
+                m_connection{&connection},
+                m_text{std::move(text)},
+                m_bind{std::move(bind)},
+                m_batch{batch ? batch : 1}
+        {}
+
+        // the next batch, std::nullopt once every row was read
+        AsyncOperation<std::optional<std::vector<T>>> Next()
+        {
+            return AsyncOperation<std::optional<std::vector<T>>>(*m_pool, [this] { return Fetch(); });
+        }
+};
+
+template <typename F>
+auto AsyncPool::Run(Connection const & connection, F work)
+{
+    using R = std::invoke_result_t<F &, Connection const &>;
+
+    return AsyncOperation<R>(*this, [&connection, work = std::move(work)]() mutable
+    {
+        return work(connection);
+    });
+}
+
+template <typename ... Values>
+auto AsyncPool::Execute(Connection const & connection, char const * const text, Values && ... values)
+{
+    return Run(connection, [text = std::string(text),
+            values = StoredValues<Values ...>(std::forward<Values>(values)...)](Connection const & target)
+    {
+        std::apply([&](auto const & ... stored)
+        {
+            ::Execute(target, text.c_str(), stored ...);
+        }, values);
+    });
+}
+
+template <typename T, typename ... Values>
+auto AsyncPool::SelectBatches(Connection const & connection, std::size_t const batch, char const * const text,
+        Values && ... values)
+{
+    return AsyncQuery<T>(*this, connection, text,
+            [values = StoredValues<Values ...>(std::forward<Values>(values)...)](Statement const & statement)
+    {
+        std::apply([&](auto const & ... stored)
+        {
+            statement.BindAll(stored ...);
+        }, values);
+    }, batch);
+}
+
+template <typename T, typename ... Values>
+auto AsyncPool::Select(Connection const & connection, char const * const text, Values && ... values)
+{
+    return SelectBatches<T>(connection, 256, text, std::forward<Values>(values)...);
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <string>
+#include <thread>
+
+#include "TacoLite.h"
+
+/*
+ * INCREMENTAL BACKUP ON ITS OWN THREAD
+ * The source connection keeps being used by the rest of the program, so it
+ * must not be opened with SQLITE_OPEN_NOMUTEX.
+ * */
+class BackgroundBackup
+{
+        std::string m_filename;
+        std::atomic<bool> m_cancel{false};
+        std::atomic<bool> m_running{true};
+        std::atomic<int> m_remaining{0};
+        std::atomic<int> m_pageCount{0};
+        bool m_completed = false;
+        std::exception_ptr m_error;
+        std::thread m_thread;
+
+        void Run(Connection const & source, BackupOptions const options) noexcept
+        {
+            try
+            {
+                Connection destination(m_filename.c_str());
+
+                m_completed = IncrementalBackup(destination, source, options,
+                        [this](BackupProgress const & progress)
+                {
+                    m_remaining = progress.Remaining;
+                    m_pageCount = progress.PageCount;
+                    return !m_cancel.load();
+                });
+            }
+            catch(...)
+            {
+                m_error = std::current_exception();
+            }
+            m_running = false;
+        }
+
+    public:
+        BackgroundBackup(Connection const & source, char const * const filename,
+                BackupOptions const & options = BackupOptions()) :
+                m_filename{filename}
+        {
+            m_thread = std::thread([this, &source, options] { Run(source, options); });
+        }
+
+        BackgroundBackup(BackgroundBackup const &) = delete;
+        BackgroundBackup & operator=(BackgroundBackup const &) = delete;
+
+        // an unfinished backup is cancelled and its file rolled back,
+        // errors are lost unless Wait was called
+        ~BackgroundBackup() noexcept
+        {
+            Cancel();
+            if(m_thread.joinable())
+            {
+                m_thread.join();
+            }
+        }
+
+        // stops after the slice being copied, the destination file is rolled back
+        // to what it held before the backup, nothing copied so far is kept
+        void Cancel() noexcept
+        {
+            m_cancel = true;
+        }
+
+        bool Running() const noexcept
+        {
+            return m_running;
+        }
+
+        BackupProgress Progress() const noexcept
+        {
+            return BackupProgress{m_remaining, m_pageCount};
+        }
+
+        // true when every page was copied, false when cancelled and the file
+        // left as it was, errors from the backup thread are thrown here
+        bool Wait()
+        {
+            if(m_thread.joinable())
+            {
+                m_thread.join();
+            }
+            if(m_error)
+            {
+                std::rethrow_exception(m_error);
+            }
+            return m_completed;
+        }
+};
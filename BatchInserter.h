@@ -0,0 +1,322 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "TacoLite.h"
+
+/*
+ * BULK INSERTS INTO ONE TABLE
+ * Rows are bound into a single multi row statement:
+ *     insert into T (a, b) select * from (values (?, ?), (?, ?), ...) limit ?
+ * it is stepped once every RowsPerStatement rows and the trailing limit lets
+ * the same statement flush a partial chunk.
+ * Transactions are opened and committed by the inserter itself.
+ * */
+
+struct BatchOptions
+{
+    // rows bound to one statement, capped by the SQLITE_LIMIT_VARIABLE_NUMBER of the connection
+    unsigned RowsPerStatement = 64;
+    // commit when a transaction holds this many rows or is this old
+    unsigned long long CommitRows = 100000;
+    std::chrono::milliseconds CommitInterval{1000};
+};
+
+struct BatchInserterStats
+{
+    unsigned long long Rows = 0;
+    unsigned long long Statements = 0;
+    unsigned long long Transactions = 0;
+    // from the first row to the last commit
+    double Seconds = 0;
+
+    double RowsPerSecond() const noexcept
+    {
+        return Seconds > 0 ? Rows / Seconds : 0;
+    }
+};
+
+class BatchInserter
+{
+        using Clock = std::chrono::steady_clock;
+
+        Connection const * m_connection = nullptr;
+        Statement m_insert;
+        BatchOptions m_options;
+        int m_columns = 0;
+        unsigned m_rowsPerStatement = 1;
+        // rows bound but not stepped yet
+        unsigned m_pending = 0;
+
+        bool m_ownsTransaction = false;
+        unsigned long long m_transactionRows = 0;
+        Clock::time_point m_transactionStart;
+
+        bool m_started = false;
+        Clock::time_point m_start;
+        BatchInserterStats m_stats;
+        // exceptions in flight when constructed, more in the destructor means unwinding
+        int m_exceptions = std::uncaught_exceptions();
+
+        // rows wait in the statement until their chunk is stepped, so text and
+        // blobs are always copied by sqlite
+        template <typename Value>
+        void BindCopy(int const index, Value && value) const
+        {
+            using Plain = std::decay_t<Value>;
+
+            if constexpr (std::is_same_v<Plain, std::string> || std::is_same_v<Plain, std::string_view> ||
+                          std::is_same_v<Plain, char const *> || std::is_same_v<Plain, char *>)
+            {
+                m_insert.Bind(index, std::string_view(value), Lifetime::Transient);
+            }
+            else if constexpr (std::is_convertible_v<Value, std::span<std::byte const>>)
+            {
+                m_insert.Bind(index, std::span<std::byte const>(value), Lifetime::Transient);
+            }
+            else if constexpr (std::is_same_v<Plain, std::wstring>)
+            {
+                // rvalues are bound with SQLITE_TRANSIENT
+                m_insert.Bind(index, std::wstring(value));
+            }
+            else if constexpr (std::is_same_v<Plain, wchar_t const *> || std::is_same_v<Plain, wchar_t *>)
+            {
+                m_insert.Bind(index, std::wstring(value));
+            }
+            else
+            {
+                m_insert.Bind(index, std::forward<Value>(value));
+            }
+        }
+
+        void BindRow(int) const noexcept
+        {}
+
+        template <typename First, typename ... Rest>
+        void BindRow(int const index, First && first, Rest && ... rest) const
+        {
+            BindCopy(index, std::forward<First>(first));
+            BindRow(index + 1, std::forward<Rest>(rest)...);
+        }
+
+        void Begin()
+        {
+            // an outer transaction opened by the caller is left alone
+            if(m_ownsTransaction || !sqlite3_get_autocommit(m_connection->GetAbi())) return;
+
+            Execute(*m_connection, "begin");
+            m_ownsTransaction = true;
+            m_transactionStart = Clock::now();
+        }
+
+        void StepChunk()
+        {
+            if(!m_pending) return;
+
+            Begin();
+
+            unsigned const rows = m_pending;
+            m_pending = 0;
+
+            // the limit parameter goes after every row
+            m_insert.Bind(static_cast<int>(m_rowsPerStatement) * m_columns + 1, static_cast<int>(rows));
+            try
+            {
+                m_insert.Execute();
+            }
+            catch(...)
+            {
+                // a statement left unreset refuses every later bind, its error is the one thrown
+                sqlite3_reset(m_insert.GetAbi());
+                throw;
+            }
+            m_insert.Reset();
+
+            m_stats.Rows += rows;
+            ++m_stats.Statements;
+            m_transactionRows += rows;
+
+            if(m_transactionRows >= m_options.CommitRows ||
+               Clock::now() - m_transactionStart >= m_options.CommitInterval)
+            {
+                Commit();
+            }
+        }
+
+        void Commit()
+        {
+            if(m_ownsTransaction)
+            {
+                Execute(*m_connection, "commit");
+                m_ownsTransaction = false;
+                ++m_stats.Transactions;
+            }
+            m_transactionRows = 0;
+            m_transactionStart = Clock::now();
+
+            if(m_started)
+            {
+                m_stats.Seconds = std::chrono::duration<double>(Clock::now() - m_start).count();
+            }
+        }
+
+    public:
+        BatchInserter(Connection const & connection, std::string const & table,
+                std::vector<std::string> const & columns, BatchOptions const & options = BatchOptions()) :
+                m_connection{&connection},
+                m_options{options},
+                m_columns{static_cast<int>(columns.size())}
+        {
+            if(columns.empty())
+            {
+                throw Exception(SQLITE_MISUSE, "batch insert into " + table + " without columns");
+            }
+
+            // one variable is kept for the limit
+            int const variables = sqlite3_limit(connection.GetAbi(), SQLITE_LIMIT_VARIABLE_NUMBER, -1);
+            unsigned const fits = static_cast<unsigned>((variables - 1) / m_columns);
+            m_rowsPerStatement = std::max(1u, std::min(m_options.RowsPerStatement, fits));
+
+            std::string row = "(";
+            for(int column = 0; column != m_columns; ++column)
+            {
+                row += column ? ", ?" : "?";
+            }
+            row += ")";
+
+            std::string text = "insert into " + QuoteName(table) + " (";
+            for(std::size_t column = 0; column != columns.size(); ++column)
+            {
+                if(column) text += ", ";
+                text += QuoteName(columns[column]);
+            }
+            text += ") select * from (values ";
+            for(unsigned chunk = 0; chunk != m_rowsPerStatement; ++chunk)
+            {
+                if(chunk) text += ", ";
+                text += row;
+            }
+            text += ") limit ?";
+
+            m_insert.Prepare(connection, text.c_str());
+        }
+
+        BatchInserter(BatchInserter const &) = delete;
+        BatchInserter & operator=(BatchInserter const &) = delete;
+
+        // pending rows are committed, errors here can only be seen by calling Flush first;
+        // while an exception unwinds the open transaction is rolled back instead,
+        // like a Transaction does; chunks committed earlier stay in the table
+        ~BatchInserter() noexcept
+        {
+            if(std::uncaught_exceptions() > m_exceptions)
+            {
+                Rollback();
+                return;
+            }
+
+            try
+            {
+                Flush();
+            }
+            catch(...)
+            {
+                Rollback();
+            }
+        }
+
+        // one row, a value for each column
+        template <typename ... Values>
+        void Insert(Values && ... values)
+        {
+            if(static_cast<int>(sizeof...(Values)) != m_columns)
+            {
+                throw Exception(SQLITE_RANGE, "batch insert row does not match the columns");
+            }
+
+            if(!m_started)
+            {
+                m_started = true;
+                m_start = Clock::now();
+                m_transactionStart = m_start;
+            }
+
+            BindRow(static_cast<int>(m_pending) * m_columns + 1, std::forward<Values>(values)...);
+
+            // a slow trickle of rows does not hold an open transaction past the interval
+            if(++m_pending == m_rowsPerStatement ||
+               (m_ownsTransaction && Clock::now() - m_transactionStart >= m_options.CommitInterval))
+            {
+                StepChunk();
+            }
+        }
+
+        // a std::tuple, std::pair or std::array
+        template <typename Tuple>
+        void InsertTuple(Tuple && row)
+        {
+            std::apply([this](auto && ... values)
+            {
+                Insert(std::forward<decltype(values)>(values)...);
+            }, std::forward<Tuple>(row));
+        }
+
+        // every element of a range, each one a tuple
+        template <typename Range>
+        void InsertAll(Range const & rows)
+        {
+            for(auto const & row : rows)
+            {
+                InsertTuple(row);
+            }
+        }
+
+        // structs or any other element, projection returns a tuple such as std::tie(u.Id, u.Name)
+        template <typename Range, typename Projection>
+        void InsertAll(Range const & rows, Projection projection)
+        {
+            for(auto const & row : rows)
+            {
+                InsertTuple(projection(row));
+            }
+        }
+
+        // stepping pending rows and committing
+        void Flush()
+        {
+            StepChunk();
+            Commit();
+        }
+
+        // discarding pending rows and the open transaction
+        void Rollback() noexcept
+        {
+            m_pending = 0;
+            m_transactionRows = 0;
+
+            if(m_ownsTransaction)
+            {
+                sqlite3_exec(m_connection->GetAbi(), "rollback", nullptr, nullptr, nullptr);
+                m_ownsTransaction = false;
+            }
+        }
+
+        unsigned RowsPerStatement() const noexcept
+        {
+            return m_rowsPerStatement;
+        }
+
+        BatchInserterStats Stats() const noexcept
+        {
+            return m_stats;
+        }
+};
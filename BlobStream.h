@@ -0,0 +1,181 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+#include "TacoLite.h"
+
+/*
+ * INCREMENTAL BLOB I/O
+ * A blob read or written a slice at a time, so a large value never sits whole
+ * in memory. Blobs can not grow: room is made on insert with ZeroBlob
+ *
+ *     Execute(connection, "insert into Documents (Id, Body) values (?, ?)", id, ZeroBlob{size});
+ *     BlobStream body(connection, "Documents", "Body", connection.RowId(), BlobMode::Write);
+ *     body.WriteFrom([&](std::span<std::byte> chunk) { return std::fread(chunk.data(), 1, chunk.size(), file); });
+ *
+ * and the handle moves to other rows of the same column with Reopen.
+ * A blob handle is aborted, reads and writes throw SQLITE_ABORT, once its row
+ * is changed by anything but the handle itself.
+ * */
+
+enum class BlobMode
+{
+        Read,
+        Write,
+};
+
+class BlobStream
+{
+        struct BlobHandleTraits : HandleTraits<sqlite3_blob *>
+        {
+            static void Close(Type value) noexcept
+            {
+                VERIFY_(SQLITE_OK, sqlite3_blob_close(value));
+            }
+        };
+
+        using BlobHandle = Handle<BlobHandleTraits>;
+
+        BlobHandle m_handle;
+        // errors are reported by the connection
+        sqlite3 * m_connection = nullptr;
+        int m_size = 0;
+        int m_position = 0;
+
+        void Check(int const result) const
+        {
+            if(SQLITE_OK != result)
+            {
+                throw Exception(m_connection);
+            }
+        }
+
+    public:
+        // slices moved by ReadTo and WriteFrom
+        static constexpr std::size_t DefaultChunk = 64 * 1024;
+
+        BlobStream() noexcept = default;
+
+        BlobStream(Connection const & connection, char const * const table, char const * const column,
+                long long const row, BlobMode const mode = BlobMode::Read, char const * const database = "main")
+        {
+            Open(connection, table, column, row, mode, database);
+        }
+
+        explicit operator bool() const noexcept
+        {
+            return static_cast<bool>(m_handle);
+        }
+
+        sqlite3_blob * GetAbi() const noexcept
+        {
+            return m_handle.Get();
+        }
+
+        void Open(Connection const & connection, char const * const table, char const * const column,
+                long long const row, BlobMode const mode = BlobMode::Read, char const * const database = "main")
+        {
+            BlobHandle opened;
+            if(SQLITE_OK != sqlite3_blob_open(connection.GetAbi(), database, table, column, row,
+                    mode == BlobMode::Write ? 1 : 0, opened.Set()))
+            {
+                connection.ThrowLastError();
+            }
+
+            m_handle = std::move(opened);
+            m_connection = connection.GetAbi();
+            m_size = sqlite3_blob_bytes(m_handle.Get());
+            m_position = 0;
+        }
+
+        // the same column of another row, much cheaper than opening a new handle
+        void Reopen(long long const row)
+        {
+            // a failed reopen leaves the handle aborted
+            m_size = 0;
+            m_position = 0;
+            Check(sqlite3_blob_reopen(GetAbi(), row));
+            m_size = sqlite3_blob_bytes(GetAbi());
+        }
+
+        int Size() const noexcept
+        {
+            return m_size;
+        }
+
+        // where the next Read or Write starts
+        int Position() const noexcept
+        {
+            return m_position;
+        }
+
+        void Seek(int const position) noexcept
+        {
+            m_position = std::clamp(position, 0, m_size);
+        }
+
+        // exactly buffer.size() bytes starting at offset
+        void ReadAt(int const offset, std::span<std::byte> const buffer) const
+        {
+            Check(sqlite3_blob_read(GetAbi(), buffer.data(), static_cast<int>(buffer.size()), offset));
+        }
+
+        // the blob does not grow, writing past its size throws
+        void WriteAt(int const offset, std::span<std::byte const> const data) const
+        {
+            Check(sqlite3_blob_write(GetAbi(), data.data(), static_cast<int>(data.size()), offset));
+        }
+
+        // the next bytes, fewer at the end of the blob, 0 once it is over
+        std::size_t Read(std::span<std::byte> const buffer)
+        {
+            auto const count = std::min(buffer.size(), static_cast<std::size_t>(m_size - m_position));
+            if(count)
+            {
+                ReadAt(m_position, buffer.first(count));
+                m_position += static_cast<int>(count);
+            }
+            return count;
+        }
+
+        void Write(std::span<std::byte const> const data)
+        {
+            WriteAt(m_position, data);
+            m_position += static_cast<int>(data.size());
+        }
+
+        // the rest of the blob to sink(std::span<std::byte const>) through one buffer of chunk bytes
+        template <typename F>
+        void ReadTo(F sink, std::size_t const chunk = DefaultChunk)
+        {
+            std::vector<std::byte> buffer(std::max<std::size_t>(1, std::min(chunk, static_cast<std::size_t>(m_size - m_position))));
+
+            while(std::size_t const count = Read(buffer))
+            {
+                sink(std::span<std::byte const>(buffer.data(), count));
+            }
+        }
+
+        // filling the rest of the blob from source(std::span<std::byte>), which returns the
+        // number of bytes it wrote in the buffer, 0 when it has no more; the bytes written are returned
+        template <typename F>
+        std::size_t WriteFrom(F source, std::size_t const chunk = DefaultChunk)
+        {
+            std::vector<std::byte> buffer(std::max<std::size_t>(1, std::min(chunk, static_cast<std::size_t>(m_size - m_position))));
+            std::size_t total = 0;
+
+            while(m_position != m_size)
+            {
+                auto const room = std::min(buffer.size(), static_cast<std::size_t>(m_size - m_position));
+                std::size_t const count = source(std::span<std::byte>(buffer.data(), room));
+                if(!count) break;
+
+                Write(std::span<std::byte const>(buffer.data(), std::min(count, room)));
+                total += std::min(count, room);
+            }
+            return total;
+        }
+};
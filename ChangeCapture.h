@@ -0,0 +1,196 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "TacoLite.h"
+
+/*
+ * CHANGE DATA CAPTURE
+ * A session records the rows changed through a connection and hands them out
+ * as changesets, applied to another database with ApplyChangeset. A replica
+ * costs what changed instead of a copy of every page:
+ *
+ *     ChangeCapture capture(primary);
+ *     Execute(primary, "update Users set Name = ? where Id = ?", "Ana", 2);
+ *
+ *     Changeset changes = capture.Take();
+ *     ApplyChangeset(replica, changes.Bytes());
+ *
+ * Take returns the net changes committed since the previous Take, one
+ * transaction or a batch of them. Changes rolled back leave nothing behind.
+ * Only tables with a primary key are recorded.
+ *
+ * Needs sqlite built with SQLITE_ENABLE_SESSION and SQLITE_ENABLE_PREUPDATE_HOOK,
+ * and SQLITE_ENABLE_SESSION defined when compiling, sqlite3.h declares the
+ * session functions only then. The conan sqlite package has no session
+ * extension, cmake -DTACOLITE_SESSION=ON builds tests/ChangeCaptureTest.cpp
+ * against a sqlite that has it.
+ * */
+
+#ifndef SQLITE_ENABLE_SESSION
+#error "ChangeCapture.h needs SQLITE_ENABLE_SESSION, see the comment above"
+#endif
+
+// a changeset allocated by sqlite
+class Changeset
+{
+        struct ChangesetHandleTraits : HandleTraits<void *>
+        {
+            static void Close(Type value) noexcept
+            {
+                sqlite3_free(value);
+            }
+        };
+
+        Handle<ChangesetHandleTraits> m_data;
+        int m_size = 0;
+
+    public:
+        Changeset() noexcept = default;
+
+        Changeset(void * const data, int const size) noexcept :
+        m_data{data},
+        m_size{size}
+        {}
+
+        explicit operator bool() const noexcept
+        {
+            return m_size != 0;
+        }
+
+        std::span<std::byte const> Bytes() const noexcept
+        {
+            return {static_cast<std::byte const *>(m_data.Get()), static_cast<std::size_t>(m_size)};
+        }
+};
+
+class ChangeCapture
+{
+        struct SessionHandleTraits : HandleTraits<sqlite3_session *>
+        {
+            static void Close(Type value) noexcept
+            {
+                sqlite3session_delete(value);
+            }
+        };
+
+        using SessionHandle = Handle<SessionHandleTraits>;
+
+        Connection const * m_connection = nullptr;
+        std::string m_database;
+        // every table when empty
+        std::vector<std::string> m_tables;
+        SessionHandle m_session;
+
+        SessionHandle Start() const
+        {
+            SessionHandle session;
+            if(SQLITE_OK != sqlite3session_create(m_connection->GetAbi(), m_database.c_str(), session.Set()))
+            {
+                m_connection->ThrowLastError();
+            }
+
+            if(m_tables.empty())
+            {
+                Check(sqlite3session_attach(session.Get(), nullptr));
+            }
+            for(std::string const & table : m_tables)
+            {
+                Check(sqlite3session_attach(session.Get(), table.c_str()));
+            }
+            return session;
+        }
+
+        static void Check(int const result)
+        {
+            if(SQLITE_OK != result)
+            {
+                throw Exception(result, "change capture failed: " + std::string(sqlite3_errstr(result)));
+            }
+        }
+
+    public:
+        explicit ChangeCapture(Connection const & connection, std::vector<std::string> tables = {},
+                std::string database = "main") :
+        m_connection{&connection},
+        m_database{std::move(database)},
+        m_tables{std::move(tables)}
+        {
+            m_session = Start();
+        }
+
+        // nothing changed since the last Take
+        bool Empty() const noexcept
+        {
+            return sqlite3session_isempty(m_session.Get());
+        }
+
+        // the changes since the previous Take, recording starts again from here;
+        // taken between transactions, so an open one can not be half captured
+        Changeset Take()
+        {
+            if(!sqlite3_get_autocommit(m_connection->GetAbi()))
+            {
+                throw Exception(SQLITE_MISUSE, "changes are taken between transactions");
+            }
+            if(Empty()) return Changeset();
+
+            // the next session is attached first, no change falls between the two
+            SessionHandle next = Start();
+
+            int size = 0;
+            void * data = nullptr;
+            Check(sqlite3session_changeset(m_session.Get(), &size, &data));
+
+            m_session = std::move(next);
+            return Changeset(data, size);
+        }
+};
+
+// what ApplyChangeset does with a change that does not fit the target
+enum class ConflictPolicy
+{
+        // nothing is applied and SQLITE_ABORT is thrown
+        Abort,
+        // the change replaces the row in the way, changes to missing rows are skipped
+        Replace,
+        // the change is skipped
+        Omit,
+};
+
+// every change in one savepoint of the target, all or nothing under Abort
+inline void ApplyChangeset(Connection const & target, std::span<std::byte const> const changeset,
+        ConflictPolicy const policy = ConflictPolicy::Abort)
+{
+    if(changeset.empty()) return;
+
+    auto const conflict = [](void * const context, int const reason, sqlite3_changeset_iter *) noexcept
+    {
+        switch(*static_cast<ConflictPolicy const *>(context))
+        {
+            case ConflictPolicy::Abort:
+                return SQLITE_CHANGESET_ABORT;
+            case ConflictPolicy::Replace:
+                // only a row that exists with other values can be replaced
+                if(reason == SQLITE_CHANGESET_DATA || reason == SQLITE_CHANGESET_CONFLICT)
+                {
+                    return SQLITE_CHANGESET_REPLACE;
+                }
+                return SQLITE_CHANGESET_OMIT;
+            default:
+                return SQLITE_CHANGESET_OMIT;
+        }
+    };
+
+    int const result = sqlite3changeset_apply(target.GetAbi(), static_cast<int>(changeset.size()),
+            const_cast<std::byte *>(changeset.data()), nullptr, conflict, const_cast<ConflictPolicy *>(&policy));
+
+    if(SQLITE_OK != result)
+    {
+        throw Exception(result, "changeset not applied: " + std::string(sqlite3_errstr(result)));
+    }
+}
@@ -0,0 +1,308 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "TacoLite.h"
+
+/*
+ * COLUMNAR FETCH
+ * Rows are read in batches into one contiguous buffer per column, so the
+ * caller can loop over plain arrays instead of calling sqlite per cell:
+ *
+ *     ColumnBatch<long long, double, std::string_view> batch(4096);
+ *     while(FetchColumns(statement, batch))
+ *     {
+ *         for(double weight : batch.Column<1>().Values()) { ... }
+ *     }
+ * */
+
+// one bit per row, set when the value is null
+class NullBitmap
+{
+        std::vector<std::uint64_t> m_words;
+
+    public:
+        void Clear(std::size_t const rows)
+        {
+            m_words.assign((rows + 63) / 64, 0);
+        }
+
+        void Set(std::size_t const row) noexcept
+        {
+            m_words[row / 64] |= std::uint64_t(1) << (row % 64);
+        }
+
+        bool IsNull(std::size_t const row) const noexcept
+        {
+            return (m_words[row / 64] >> (row % 64)) & 1;
+        }
+
+        std::span<std::uint64_t const> Words() const noexcept
+        {
+            return m_words;
+        }
+};
+
+// numbers, nulls are stored as zero
+template <typename T>
+class ColumnBuffer
+{
+        std::vector<T> m_values;
+        NullBitmap m_nulls;
+
+    public:
+        void Clear(std::size_t const capacity)
+        {
+            m_values.clear();
+            m_values.reserve(capacity);
+            m_nulls.Clear(capacity);
+        }
+
+        void Append(sqlite3_stmt * const statement, int const column)
+        {
+            if(sqlite3_column_type(statement, column) == SQLITE_NULL)
+            {
+                m_nulls.Set(m_values.size());
+                m_values.push_back(T());
+                return;
+            }
+            m_values.push_back(ColumnTraits<T>::Get(statement, column));
+        }
+
+        std::size_t Size() const noexcept
+        {
+            return m_values.size();
+        }
+
+        std::span<T const> Values() const noexcept
+        {
+            return m_values;
+        }
+
+        T operator[](std::size_t const row) const noexcept
+        {
+            return m_values[row];
+        }
+
+        bool IsNull(std::size_t const row) const noexcept
+        {
+            return m_nulls.IsNull(row);
+        }
+
+        NullBitmap const & Nulls() const noexcept
+        {
+            return m_nulls;
+        }
+};
+
+// text and blobs: every value of the batch in one arena, row N is the bytes
+// between Offsets()[N] and Offsets()[N + 1]
+template <typename Byte>
+class ArenaColumnBuffer
+{
+        std::vector<std::size_t> m_offsets{0};
+        std::vector<Byte> m_bytes;
+        NullBitmap m_nulls;
+
+    protected:
+        void Append(sqlite3_stmt * const statement, int const column, void const * const data)
+        {
+            std::size_t const row = m_offsets.size() - 1;
+
+            if(!data && sqlite3_column_type(statement, column) == SQLITE_NULL)
+            {
+                m_nulls.Set(row);
+            }
+            else
+            {
+                // the length is asked after the value, so it matches its encoding
+                auto const bytes = static_cast<Byte const *>(data);
+                m_bytes.insert(m_bytes.end(), bytes, bytes + sqlite3_column_bytes(statement, column));
+            }
+            m_offsets.push_back(m_bytes.size());
+        }
+
+        std::span<Byte const> Bytes(std::size_t const row) const noexcept
+        {
+            return std::span<Byte const>(m_bytes.data() + m_offsets[row], m_offsets[row + 1] - m_offsets[row]);
+        }
+
+    public:
+        void Clear(std::size_t const capacity)
+        {
+            m_offsets.clear();
+            m_offsets.reserve(capacity + 1);
+            m_offsets.push_back(0);
+            // the arena keeps whatever it grew to in previous batches
+            m_bytes.clear();
+            m_nulls.Clear(capacity);
+        }
+
+        std::size_t Size() const noexcept
+        {
+            return m_offsets.size() - 1;
+        }
+
+        std::span<std::size_t const> Offsets() const noexcept
+        {
+            return m_offsets;
+        }
+
+        std::span<Byte const> Arena() const noexcept
+        {
+            return m_bytes;
+        }
+
+        bool IsNull(std::size_t const row) const noexcept
+        {
+            return m_nulls.IsNull(row);
+        }
+
+        NullBitmap const & Nulls() const noexcept
+        {
+            return m_nulls;
+        }
+};
+
+template <>
+class ColumnBuffer<std::string_view> : public ArenaColumnBuffer<char>
+{
+    public:
+        void Append(sqlite3_stmt * const statement, int const column)
+        {
+            ArenaColumnBuffer::Append(statement, column, sqlite3_column_text(statement, column));
+        }
+
+        // valid until the next fetch into this batch
+        std::string_view operator[](std::size_t const row) const noexcept
+        {
+            std::span<char const> const text = Bytes(row);
+            return std::string_view(text.data(), text.size());
+        }
+};
+
+template <>
+class ColumnBuffer<std::span<std::byte const>> : public ArenaColumnBuffer<std::byte>
+{
+    public:
+        void Append(sqlite3_stmt * const statement, int const column)
+        {
+            ArenaColumnBuffer::Append(statement, column, sqlite3_column_blob(statement, column));
+        }
+
+        // valid until the next fetch into this batch
+        std::span<std::byte const> operator[](std::size_t const row) const noexcept
+        {
+            return Bytes(row);
+        }
+};
+
+template <typename ... Types>
+class ColumnBatch
+{
+        std::tuple<ColumnBuffer<Types> ...> m_columns;
+        std::size_t m_capacity = 0;
+        std::size_t m_rows = 0;
+        // the statement reached its end, sqlite would start it over if it was
+        // stepped again, so fetching stops until Clear
+        bool m_done = false;
+        // a fetch already returned 0 for that end, another one is a statement
+        // reset without a Clear and throws instead of reading nothing
+        bool m_ended = false;
+
+        void ClearRows()
+        {
+            m_rows = 0;
+            std::apply([this](auto & ... columns) { (columns.Clear(m_capacity), ...); }, m_columns);
+        }
+
+        template <std::size_t ... Indexes>
+        void AppendRow(sqlite3_stmt * const statement, std::index_sequence<Indexes ...>)
+        {
+            (std::get<Indexes>(m_columns).Append(statement, static_cast<int>(Indexes)), ...);
+        }
+
+        template <typename ... Others>
+        friend std::size_t FetchColumns(Statement const & statement, ColumnBatch<Others ...> & batch);
+
+    public:
+        explicit ColumnBatch(std::size_t const capacity = 1024) :
+        m_capacity{capacity ? capacity : 1}
+        {
+            Clear();
+        }
+
+        // ready for a statement that was reset or another one
+        void Clear()
+        {
+            m_done = false;
+            m_ended = false;
+            ClearRows();
+        }
+
+        // the last fetch read the final rows of the statement
+        bool Done() const noexcept
+        {
+            return m_done;
+        }
+
+        std::size_t Rows() const noexcept
+        {
+            return m_rows;
+        }
+
+        std::size_t Capacity() const noexcept
+        {
+            return m_capacity;
+        }
+
+        template <std::size_t Index>
+        auto const & Column() const noexcept
+        {
+            return std::get<Index>(m_columns);
+        }
+};
+
+// steps the statement until the batch is full, returns the rows read, 0 once
+// the statement is over; Clear the batch before fetching again after a Reset,
+// fetching past the 0 without it throws
+template <typename ... Types>
+std::size_t FetchColumns(Statement const & statement, ColumnBatch<Types ...> & batch)
+{
+    batch.ClearRows();
+    if(batch.m_done)
+    {
+        if(batch.m_ended)
+        {
+            throw Exception(SQLITE_MISUSE, "column batch fetched after its statement ended, Clear it after a Reset");
+        }
+        batch.m_ended = true;
+        return 0;
+    }
+
+    sqlite3_stmt * const abi = statement.GetAbi();
+
+    // checked once per batch, not per row
+    CheckColumns<std::tuple<Types ...>>(abi);
+
+    while(batch.m_rows != batch.m_capacity)
+    {
+        if(!statement.Step())
+        {
+            batch.m_done = true;
+            break;
+        }
+
+        batch.AppendRow(abi, std::index_sequence_for<Types ...>());
+        ++batch.m_rows;
+    }
+
+    if(batch.m_done && !batch.m_rows) batch.m_ended = true;
+    return batch.m_rows;
+}
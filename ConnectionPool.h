@@ -0,0 +1,206 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "TacoLite.h"
+
+/*
+ * CONNECTION POOL FOR ONE DATABASE FILE
+ * N read only connections and a single writer, all of them in WAL mode so
+ * readers never wait for the writer.
+ * Every connection is opened with SQLITE_OPEN_NOMUTEX, the pool guarantees
+ * that only one thread at a time holds each of them.
+ * */
+
+// a set of up to 64 slots, taken and returned without locks while any is free
+class PoolSlots
+{
+        std::atomic<std::uint64_t> m_free{0};
+        std::atomic<unsigned> m_waiting{0};
+        std::mutex m_mutex;
+        std::condition_variable m_released;
+
+        bool TryAcquire(unsigned & index) noexcept
+        {
+            std::uint64_t free = m_free.load();
+
+            while(free)
+            {
+                // lowest free slot
+                std::uint64_t const bit = free & (~free + 1);
+
+                if(m_free.compare_exchange_weak(free, free & ~bit))
+                {
+                    index = 0;
+                    while(!((bit >> index) & 1)) ++index;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+    public:
+        static constexpr unsigned Capacity = 64;
+
+        explicit PoolSlots(unsigned const count) noexcept :
+        m_free{count >= Capacity ? ~std::uint64_t(0) : (std::uint64_t(1) << count) - 1}
+        {}
+
+        // blocking only when every slot is taken
+        unsigned Acquire()
+        {
+            unsigned index = 0;
+            if(TryAcquire(index)) return index;
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            ++m_waiting;
+            m_released.wait(lock, [&]{ return TryAcquire(index); });
+            --m_waiting;
+            return index;
+        }
+
+        void Release(unsigned const index) noexcept
+        {
+            m_free.fetch_or(std::uint64_t(1) << index);
+
+            if(m_waiting.load())
+            {
+                // a waiter is either before its check or already sleeping
+                { std::lock_guard<std::mutex> lock(m_mutex); }
+                m_released.notify_one();
+            }
+        }
+};
+
+class ConnectionPool;
+
+// a connection owned by the pool
+struct PooledConnection
+{
+    ConnectionPool * Pool = nullptr;
+    Connection Database;
+    unsigned Index = 0;
+    bool Writer = false;
+};
+
+// RAII checkout of a pooled connection, returned to the pool on destruction
+class ConnectionLease
+{
+        struct LeaseHandleTraits : HandleTraits<PooledConnection *>
+        {
+            // defined bellow ConnectionPool
+            static void Close(Type value) noexcept;
+        };
+
+        using LeaseHandle = Handle<LeaseHandleTraits>;
+        LeaseHandle m_handle;
+
+    public:
+        explicit ConnectionLease(PooledConnection * const connection = nullptr) noexcept :
+        m_handle{connection}
+        {}
+
+        explicit operator bool() const noexcept
+        {
+            return static_cast<bool>(m_handle);
+        }
+
+        Connection const & operator*() const noexcept
+        {
+            return m_handle.Get()->Database;
+        }
+
+        Connection const * operator->() const noexcept
+        {
+            return &m_handle.Get()->Database;
+        }
+
+        // giving the connection back before the end of the scope
+        void Release() noexcept
+        {
+            m_handle.Reset();
+        }
+};
+
+class ConnectionPool
+{
+        std::vector<PooledConnection> m_readers;
+        PooledConnection m_writer;
+        PoolSlots m_freeReaders;
+        PoolSlots m_freeWriter{1};
+
+        static unsigned DefaultReaders() noexcept
+        {
+            unsigned const cores = std::thread::hardware_concurrency();
+            // a reader per core, no more than the pool can hold
+            return cores ? std::min(cores, PoolSlots::Capacity) : 4;
+        }
+
+    public:
+        // the file must be on disk, in memory databases can not be shared this way
+        explicit ConnectionPool(char const * const filename, unsigned const readers = DefaultReaders()) :
+        m_freeReaders{readers}
+        {
+            if(readers == 0 || readers > PoolSlots::Capacity)
+            {
+                throw Exception(SQLITE_MISUSE, "connection pool readers must be between 1 and 64");
+            }
+
+            // the writer creates the file and switches it to WAL before any reader opens it
+            m_writer.Pool = this;
+            m_writer.Writer = true;
+            m_writer.Database.Open(filename, ConnectionOptions().NoMutex().Journal(JournalMode::Wal));
+
+            m_readers.resize(readers);
+            for(unsigned index = 0; index != readers; ++index)
+            {
+                m_readers[index].Pool = this;
+                m_readers[index].Index = index;
+                m_readers[index].Database.Open(filename, ConnectionOptions().ReadOnly().NoMutex());
+            }
+        }
+
+        // leases point back to the pool
+        ConnectionPool(ConnectionPool const &) = delete;
+        ConnectionPool & operator=(ConnectionPool const &) = delete;
+
+        ConnectionLease CheckoutReader()
+        {
+            return ConnectionLease(&m_readers[m_freeReaders.Acquire()]);
+        }
+
+        ConnectionLease CheckoutWriter()
+        {
+            m_freeWriter.Acquire();
+            return ConnectionLease(&m_writer);
+        }
+
+        unsigned ReaderCount() const noexcept
+        {
+            return static_cast<unsigned>(m_readers.size());
+        }
+
+        void Release(PooledConnection * const connection) noexcept
+        {
+            if(connection->Writer)
+            {
+                m_freeWriter.Release(0);
+            }
+            else
+            {
+                m_freeReaders.Release(connection->Index);
+            }
+        }
+};
+
+inline void ConnectionLease::LeaseHandleTraits::Close(Type value) noexcept
+{
+    value->Pool->Release(value);
+}
@@ -0,0 +1,473 @@
+#pragma once
+
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#endif
+
+#include "MappedFile.h"
+#include "TacoLite.h"
+#include "Transaction.h"
+
+/*
+ * CSV AND TSV IMPORTS
+ * The file is mapped in memory and split with SIMD compares, 16 or 32 bytes at a
+ * time. Fields are bound as views into the mapping (SQLITE_STATIC) through one
+ * reused insert statement, only quoted fields with "" escapes are copied:
+ *
+ *     CsvOptions options;
+ *     options.Types = {CsvType::Integer, CsvType::Text, CsvType::Real};
+ *     CsvImportStats stats = ImportCsv(connection, "events.csv", "Events", options);
+ *
+ * The columns are named by the header line, or by options.Columns.
+ * Rows are committed every CommitRows, a failure rolls back the current batch
+ * only. An open transaction of the caller is used instead.
+ * */
+
+enum class CsvType
+{
+        // bound as text, the column affinity still applies
+        Text,
+        // bound as a number when the whole field parses, text otherwise; empty fields are null
+        Integer,
+        Real,
+};
+
+struct CsvOptions
+{
+    char Delimiter = ',';
+    char Quote = '"';
+    // the first line names the columns
+    bool Header = true;
+    // column names when there is no header, or instead of it
+    std::vector<std::string> Columns;
+    // one per column, missing ones are Text
+    std::vector<CsvType> Types;
+    // empty text fields become null
+    bool EmptyIsNull = false;
+    unsigned long long CommitRows = 100000;
+
+    static CsvOptions Tsv()
+    {
+        CsvOptions options;
+        options.Delimiter = '\t';
+        return options;
+    }
+};
+
+struct CsvImportStats
+{
+    unsigned long long Rows = 0;
+    unsigned long long Bytes = 0;
+    unsigned long long Transactions = 0;
+    double Seconds = 0;
+
+    double MegabytesPerSecond() const noexcept
+    {
+        return Seconds > 0 ? Bytes / Seconds / (1024 * 1024) : 0;
+    }
+};
+
+// positions of delimiters, quotes and line ends, one block of bytes at a time
+class CsvScanner
+{
+#if defined(__AVX2__)
+        static constexpr std::size_t Width = 32;
+#else
+        static constexpr std::size_t Width = 16;
+#endif
+
+        char const * m_data;
+        std::size_t m_size;
+        char m_delimiter;
+        char m_quote;
+        // a bit for every special byte of the block starting at m_block
+        std::size_t m_block = 0;
+        std::uint32_t m_mask = 0;
+
+        std::uint32_t Mask(std::size_t const block) const noexcept
+        {
+            char const * const data = m_data + block;
+
+            if(block + Width > m_size)
+            {
+                // the tail of the text, never read past it
+                std::uint32_t mask = 0;
+                for(std::size_t index = 0; index != m_size - block; ++index)
+                {
+                    char const c = data[index];
+                    if(c == m_delimiter || c == m_quote || c == '\n' || c == '\r') mask |= 1u << index;
+                }
+                return mask;
+            }
+
+#if defined(__AVX2__)
+            __m256i const bytes = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(data));
+            __m256i const special = _mm256_or_si256(
+                    _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(m_delimiter)),
+                                    _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(m_quote))),
+                    _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\n')),
+                                    _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\r'))));
+            return static_cast<std::uint32_t>(_mm256_movemask_epi8(special));
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+            __m128i const bytes = _mm_loadu_si128(reinterpret_cast<__m128i const *>(data));
+            __m128i const special = _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(m_delimiter)),
+                                 _mm_cmpeq_epi8(bytes, _mm_set1_epi8(m_quote))),
+                    _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n')),
+                                 _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\r'))));
+            return static_cast<std::uint32_t>(_mm_movemask_epi8(special));
+#else
+            // eight bytes at a time, a zero byte in x ^ pattern marks a match
+            std::uint32_t mask = 0;
+            for(std::size_t offset = 0; offset != Width; offset += 8)
+            {
+                std::uint64_t word;
+                std::memcpy(&word, data + offset, 8);
+
+                std::uint64_t const ones = 0x0101010101010101ull;
+                auto const zero = [&](std::uint64_t const x)
+                {
+                    return (x - ones) & ~x & (ones << 7);
+                };
+                std::uint64_t const found = zero(word ^ (ones * static_cast<unsigned char>(m_delimiter))) |
+                                            zero(word ^ (ones * static_cast<unsigned char>(m_quote))) |
+                                            zero(word ^ (ones * '\n')) | zero(word ^ (ones * '\r'));
+                // the borrow may flag a byte after a real match, check each candidate
+                for(std::uint64_t bits = found; bits; bits &= bits - 1)
+                {
+                    std::size_t const index = offset + std::countr_zero(bits) / 8;
+                    char const c = data[index];
+                    if(c == m_delimiter || c == m_quote || c == '\n' || c == '\r') mask |= 1u << index;
+                }
+            }
+            return mask;
+#endif
+        }
+
+    public:
+        CsvScanner(std::string_view const text, char const delimiter, char const quote) noexcept :
+        m_data{text.data()},
+        m_size{text.size()},
+        m_delimiter{delimiter},
+        m_quote{quote}
+        {
+            m_mask = m_size ? Mask(0) : 0;
+        }
+
+        // the first special byte at or after position, the size of the text when there is none
+        std::size_t Find(std::size_t const position) noexcept
+        {
+            if(position >= m_size) return m_size;
+
+            if(position < m_block || position >= m_block + Width)
+            {
+                m_block = position;
+                m_mask = Mask(position);
+            }
+            else
+            {
+                // bits before position were already consumed
+                m_mask &= static_cast<std::uint32_t>(~((std::uint64_t(1) << (position - m_block)) - 1));
+            }
+
+            while(!m_mask)
+            {
+                m_block += Width;
+                if(m_block >= m_size) return m_size;
+                m_mask = Mask(m_block);
+            }
+            return m_block + std::countr_zero(m_mask);
+        }
+};
+
+class CsvImporter
+{
+        using Clock = std::chrono::steady_clock;
+
+        Connection const & m_connection;
+        std::string m_table;
+        CsvOptions m_options;
+
+        std::string_view m_text;
+        std::size_t m_position = 0;
+        unsigned long long m_line = 1;
+        std::vector<std::string_view> m_fields;
+        // quoted fields with escaped quotes, one per column so views stay valid until the row is stepped;
+        // a deque, growing it never moves the strings m_fields already points into
+        std::deque<std::string> m_unescaped;
+
+        [[noreturn]] void Fail(std::string const & message) const
+        {
+            throw Exception(SQLITE_MISMATCH, "line " + std::to_string(m_line) + ": " + message);
+        }
+
+        // the fields of the next record into m_fields, false at the end of the text
+        bool NextRecord(CsvScanner & scanner)
+        {
+            m_fields.clear();
+            std::size_t const size = m_text.size();
+
+            // blank lines are skipped
+            while(m_position != size && (m_text[m_position] == '\n' || m_text[m_position] == '\r'))
+            {
+                if(m_text[m_position] == '\n') ++m_line;
+                ++m_position;
+            }
+            if(m_position == size) return false;
+
+            for(;;)
+            {
+                std::size_t end;
+
+                if(m_text[m_position] == m_options.Quote)
+                {
+                    std::size_t const start = m_position + 1;
+                    std::size_t segment = start;
+                    std::string * unescaped = nullptr;
+
+                    for(;;)
+                    {
+                        std::size_t next = scanner.Find(segment);
+                        while(next != size && m_text[next] != m_options.Quote)
+                        {
+                            // line ends inside quotes belong to the field
+                            if(m_text[next] == '\n') ++m_line;
+                            next = scanner.Find(next + 1);
+                        }
+                        if(next == size) Fail("unterminated quoted field");
+
+                        if(next + 1 != size && m_text[next + 1] == m_options.Quote)
+                        {
+                            // "" is one quote, the field can not be a view of the text
+                            if(!unescaped)
+                            {
+                                if(m_unescaped.size() <= m_fields.size()) m_unescaped.resize(m_fields.size() + 1);
+                                unescaped = &m_unescaped[m_fields.size()];
+                                unescaped->clear();
+                            }
+                            unescaped->append(m_text.data() + segment, next + 1 - segment);
+                            segment = next + 2;
+                            continue;
+                        }
+
+                        if(unescaped)
+                        {
+                            unescaped->append(m_text.data() + segment, next - segment);
+                            m_fields.emplace_back(*unescaped);
+                        }
+                        else
+                        {
+                            m_fields.push_back(m_text.substr(start, next - start));
+                        }
+                        end = next + 1;
+                        break;
+                    }
+
+                    if(end != size && m_text[end] != m_options.Delimiter && m_text[end] != '\n' && m_text[end] != '\r')
+                    {
+                        Fail("characters after a closing quote");
+                    }
+                }
+                else
+                {
+                    // quotes inside an unquoted field are kept as they are
+                    end = scanner.Find(m_position);
+                    while(end != size && m_text[end] == m_options.Quote)
+                    {
+                        end = scanner.Find(end + 1);
+                    }
+                    m_fields.push_back(m_text.substr(m_position, end - m_position));
+                }
+
+                if(end == size)
+                {
+                    m_position = size;
+                    return true;
+                }
+
+                char const c = m_text[end];
+                m_position = end + 1;
+
+                if(c == m_options.Delimiter)
+                {
+                    // a delimiter at the very end still has an empty field after it
+                    if(m_position == size)
+                    {
+                        m_fields.emplace_back();
+                        return true;
+                    }
+                    continue;
+                }
+
+                if(c == '\r' && m_position != size && m_text[m_position] == '\n') ++m_position;
+                ++m_line;
+                return true;
+            }
+        }
+
+        void BindField(Statement const & insert, int const index, std::string_view const field) const
+        {
+            CsvType const type = static_cast<std::size_t>(index - 1) < m_options.Types.size() ?
+                    m_options.Types[index - 1] : CsvType::Text;
+
+            if(field.empty() && (type != CsvType::Text || m_options.EmptyIsNull))
+            {
+                insert.Bind(index, nullptr);
+                return;
+            }
+
+            char const * const last = field.data() + field.size();
+
+            if(type == CsvType::Integer)
+            {
+                long long value = 0;
+                auto const [end, error] = std::from_chars(field.data(), last, value);
+                if(error == std::errc() && end == last)
+                {
+                    insert.Bind(index, value);
+                    return;
+                }
+            }
+            else if(type == CsvType::Real)
+            {
+                double value = 0;
+                auto const [end, error] = std::from_chars(field.data(), last, value);
+                if(error == std::errc() && end == last)
+                {
+                    insert.Bind(index, value);
+                    return;
+                }
+            }
+
+            // the text outlives the statement step, no copy
+            insert.Bind(index, field, Lifetime::Static);
+        }
+
+    public:
+        CsvImporter(Connection const & connection, std::string table, CsvOptions options = CsvOptions()) :
+        m_connection{connection},
+        m_table{std::move(table)},
+        m_options{std::move(options)}
+        {
+            if(m_options.Delimiter == m_options.Quote || m_options.Delimiter == '\n' || m_options.Delimiter == '\r')
+            {
+                throw Exception(SQLITE_MISUSE, "invalid csv delimiter");
+            }
+        }
+
+        // the text must stay alive until Import returns
+        CsvImportStats Import(std::string_view text)
+        {
+            auto const start = Clock::now();
+            CsvImportStats stats;
+            stats.Bytes = text.size();
+
+            // a UTF-8 byte order mark is not part of the first column name
+            if(text.starts_with("\xEF\xBB\xBF")) text.remove_prefix(3);
+
+            m_text = text;
+            m_position = 0;
+            m_line = 1;
+            CsvScanner scanner(text, m_options.Delimiter, m_options.Quote);
+
+            std::vector<std::string> columns = m_options.Columns;
+            if(m_options.Header && NextRecord(scanner) && columns.empty())
+            {
+                columns.assign(m_fields.begin(), m_fields.end());
+            }
+
+            Statement insert;
+            std::size_t width = columns.size();
+            unsigned long long pending = 0;
+            // the caller's transaction is left alone
+            bool const owns = sqlite3_get_autocommit(m_connection.GetAbi());
+            std::optional<Transaction> transaction;
+
+            while(NextRecord(scanner))
+            {
+                if(!insert)
+                {
+                    // without names, the first record gives the number of columns
+                    if(!width) width = m_fields.size();
+
+                    std::string text = "insert into " + QuoteName(m_table);
+                    if(!columns.empty())
+                    {
+                        text += " (";
+                        for(std::size_t column = 0; column != columns.size(); ++column)
+                        {
+                            if(column) text += ", ";
+                            text += QuoteName(columns[column]);
+                        }
+                        text += ")";
+                    }
+                    text += " values (";
+                    for(std::size_t column = 0; column != width; ++column)
+                    {
+                        text += column ? ", ?" : "?";
+                    }
+                    text += ")";
+                    insert.Prepare(m_connection, text.c_str());
+                }
+
+                if(m_fields.size() != width)
+                {
+                    Fail(std::to_string(m_fields.size()) + " fields, expected " + std::to_string(width));
+                }
+
+                if(owns && !transaction) transaction.emplace(m_connection, TransactionMode::Immediate);
+
+                for(std::size_t column = 0; column != width; ++column)
+                {
+                    BindField(insert, static_cast<int>(column + 1), m_fields[column]);
+                }
+                insert.Execute();
+                insert.Reset();
+                ++stats.Rows;
+
+                if(transaction && ++pending == m_options.CommitRows)
+                {
+                    transaction->Commit();
+                    transaction.reset();
+                    ++stats.Transactions;
+                    pending = 0;
+                }
+            }
+
+            if(transaction)
+            {
+                transaction->Commit();
+                ++stats.Transactions;
+            }
+
+            stats.Seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            return stats;
+        }
+
+        CsvImportStats ImportFile(char const * const filename)
+        {
+            MappedFile const file(filename);
+            file.Sequential();
+            return Import(file.Text());
+        }
+};
+
+inline CsvImportStats ImportCsv(Connection const & connection, char const * const filename, std::string table,
+        CsvOptions options = CsvOptions())
+{
+    return CsvImporter(connection, std::move(table), std::move(options)).ImportFile(filename);
+}
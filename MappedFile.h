@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "TacoLite.h"
+
+// how the pages of a MappedFile can be used
+enum class MapMode
+{
+        Read,
+        // pages written are copied for this process alone, the file never changes
+        CopyOnWrite,
+};
+
+// a view of a whole file, pages are read from disk when they are first touched
+class MappedFile
+{
+        void * m_data = nullptr;
+        std::size_t m_size = 0;
+
+#ifdef _WIN32
+        struct FileHandleTraits : HandleTraits<HANDLE>
+        {
+            static Type Invalid() noexcept
+            {
+                return INVALID_HANDLE_VALUE;
+            }
+
+            static void Close(Type value) noexcept
+            {
+                VERIFY(CloseHandle(value));
+            }
+        };
+#else
+        struct FileHandleTraits
+        {
+            using Type = int;
+
+            static Type Invalid() noexcept
+            {
+                return -1;
+            }
+
+            static void Close(Type value) noexcept
+            {
+                VERIFY_(0, close(value));
+            }
+        };
+#endif
+
+    public:
+        explicit MappedFile(char const * const filename, MapMode const mode = MapMode::Read)
+        {
+#ifdef _WIN32
+            Handle<FileHandleTraits> file(CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                    FILE_FLAG_SEQUENTIAL_SCAN, nullptr));
+            LARGE_INTEGER size = {};
+            if(!file || !GetFileSizeEx(file.Get(), &size))
+            {
+                throw Exception(SQLITE_CANTOPEN, std::string("can not open ") + filename);
+            }
+            m_size = static_cast<std::size_t>(size.QuadPart);
+            if(!m_size) return;
+
+            // the view keeps the mapping alive
+            bool const copy = mode == MapMode::CopyOnWrite;
+            HANDLE const mapping = CreateFileMappingA(file.Get(), nullptr, copy ? PAGE_WRITECOPY : PAGE_READONLY,
+                    0, 0, nullptr);
+            if(mapping)
+            {
+                m_data = MapViewOfFile(mapping, copy ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+                CloseHandle(mapping);
+            }
+            if(!m_data)
+            {
+                throw Exception(SQLITE_IOERR, std::string("can not map ") + filename);
+            }
+#else
+            Handle<FileHandleTraits> file(open(filename, O_RDONLY));
+            struct stat status = {};
+            if(!file || fstat(file.Get(), &status))
+            {
+                throw Exception(SQLITE_CANTOPEN, std::string("can not open ") + filename);
+            }
+            m_size = static_cast<std::size_t>(status.st_size);
+            if(!m_size) return;
+
+            int const protection = mode == MapMode::CopyOnWrite ? PROT_READ | PROT_WRITE : PROT_READ;
+            void * const data = mmap(nullptr, m_size, protection, MAP_PRIVATE, file.Get(), 0);
+            if(data == MAP_FAILED)
+            {
+                throw Exception(SQLITE_IOERR, std::string("can not map ") + filename);
+            }
+            m_data = data;
+#endif
+        }
+
+        MappedFile(MappedFile const &) = delete;
+        MappedFile & operator=(MappedFile const &) = delete;
+
+        ~MappedFile() noexcept
+        {
+            if(!m_data) return;
+#ifdef _WIN32
+            VERIFY(UnmapViewOfFile(m_data));
+#else
+            VERIFY_(0, munmap(m_data, m_size));
+#endif
+        }
+
+        // read ahead aggressively and drop pages behind
+        void Sequential() const noexcept
+        {
+#ifndef _WIN32
+            if(m_data) madvise(m_data, m_size, MADV_SEQUENTIAL);
+#endif
+        }
+
+        std::string_view Text() const noexcept
+        {
+            return {static_cast<char const *>(m_data), m_size};
+        }
+
+        std::span<std::byte const> Bytes() const noexcept
+        {
+            return {static_cast<std::byte const *>(m_data), m_size};
+        }
+
+        // only for MapMode::CopyOnWrite
+        std::span<std::byte> WritableBytes() noexcept
+        {
+            return {static_cast<std::byte *>(m_data), m_size};
+        }
+};
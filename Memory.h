@@ -0,0 +1,516 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "TacoLite.h"
+
+/*
+ * SQLITE MEMORY CONFIGURATION
+ * sqlite3_config only works before sqlite is initialized, that is before the
+ * first Connection is opened (or after sqlite3_shutdown), so these functions
+ * belong at the very start of main. They throw when it is too late.
+ *
+ *     InstallAllocator<PoolAllocator>();
+ *     ConfigurePageCache(4096, 10000);
+ *     ConfigureLookaside(1200, 100);
+ * */
+
+inline void CheckConfiguration(int const result, char const * const what)
+{
+    if(result != SQLITE_OK)
+    {
+        throw Exception(result, std::string(what) + " must be configured before the first connection is opened");
+    }
+}
+
+// any class with these static members can replace malloc inside sqlite:
+//     void * Allocate(int bytes); void Free(void *); void * Reallocate(void *, int bytes);
+//     int Size(void *); int Roundup(int bytes);
+template <typename Allocator>
+void InstallAllocator()
+{
+    static sqlite3_mem_methods const methods
+    {
+        [](int const bytes) { return Allocator::Allocate(bytes); },
+        [](void * const memory) { Allocator::Free(memory); },
+        [](void * const memory, int const bytes) { return Allocator::Reallocate(memory, bytes); },
+        [](void * const memory) { return Allocator::Size(memory); },
+        [](int const bytes) { return Allocator::Roundup(bytes); },
+        [](void *) { return SQLITE_OK; },
+        [](void *) {},
+        nullptr
+    };
+    CheckConfiguration(sqlite3_config(SQLITE_CONFIG_MALLOC, &methods), "the allocator");
+}
+
+/*
+ * THREAD CACHING POOL ALLOCATOR
+ * Small blocks are rounded up to a power of two and recycled through free lists
+ * owned by each thread, so most allocations take no lock at all.
+ * Blocks freed by another thread simply join that thread's lists.
+ * */
+class PoolAllocator
+{
+        static constexpr std::size_t Classes = 8;
+        static constexpr std::size_t Smallest = 32;
+        static constexpr std::size_t Largest = Smallest << (Classes - 1);
+        // blocks kept per class and thread, the rest go back to malloc
+        static constexpr std::size_t Cached = 512;
+
+        // in front of every block, keeps the 8 byte alignment sqlite expects
+        struct Header
+        {
+            std::size_t Size;
+            std::size_t Class;
+        };
+
+        struct FreeBlock
+        {
+            FreeBlock * Next;
+        };
+
+        enum class CacheState : unsigned char
+        {
+            Unborn,
+            Alive,
+            Destroyed,
+        };
+
+        struct ThreadCache
+        {
+            FreeBlock * Lists[Classes] = {};
+            std::size_t Counts[Classes] = {};
+
+            ThreadCache() noexcept
+            {
+                State() = CacheState::Alive;
+            }
+
+            ~ThreadCache()
+            {
+                State() = CacheState::Destroyed;
+                for(FreeBlock * list : Lists)
+                {
+                    while(list)
+                    {
+                        FreeBlock * const next = list->Next;
+                        std::free(list);
+                        list = next;
+                    }
+                }
+            }
+        };
+
+        // trivially destructible, still readable after the cache of a thread is gone;
+        // a destroyed cache is never touched again, late frees of the thread go to malloc
+        static CacheState & State() noexcept
+        {
+            thread_local CacheState state = CacheState::Unborn;
+            return state;
+        }
+
+        static ThreadCache & Cache() noexcept
+        {
+            thread_local ThreadCache cache;
+            return cache;
+        }
+
+        static std::size_t ClassOf(std::size_t const bytes) noexcept
+        {
+            std::size_t size = Smallest;
+            std::size_t index = 0;
+            while(size < bytes)
+            {
+                size <<= 1;
+                ++index;
+            }
+            return index;
+        }
+
+        static Header * HeaderOf(void * const memory) noexcept
+        {
+            return static_cast<Header *>(memory) - 1;
+        }
+
+    public:
+        static void * Allocate(int const bytes) noexcept
+        {
+            std::size_t const size = static_cast<std::size_t>(Roundup(bytes));
+            std::size_t const index = size <= Largest ? ClassOf(size) : Classes;
+
+            void * block = nullptr;
+
+            if(index != Classes && State() == CacheState::Alive)
+            {
+                ThreadCache & cache = Cache();
+                if(cache.Lists[index])
+                {
+                    block = cache.Lists[index];
+                    cache.Lists[index] = cache.Lists[index]->Next;
+                    --cache.Counts[index];
+                }
+            }
+            else if(index != Classes && State() == CacheState::Unborn)
+            {
+                // first allocation of the thread creates its cache
+                Cache();
+            }
+
+            if(!block)
+            {
+                block = std::malloc(sizeof(Header) + size);
+                if(!block) return nullptr;
+            }
+
+            auto const header = static_cast<Header *>(block);
+            header->Size = size;
+            header->Class = index;
+            return header + 1;
+        }
+
+        static void Free(void * const memory) noexcept
+        {
+            if(!memory) return;
+
+            Header * const header = HeaderOf(memory);
+            std::size_t const index = header->Class;
+
+            if(index != Classes && State() == CacheState::Alive)
+            {
+                ThreadCache & cache = Cache();
+                if(cache.Counts[index] < Cached)
+                {
+                    auto const block = reinterpret_cast<FreeBlock *>(header);
+                    block->Next = cache.Lists[index];
+                    cache.Lists[index] = block;
+                    ++cache.Counts[index];
+                    return;
+                }
+            }
+            std::free(header);
+        }
+
+        static void * Reallocate(void * const memory, int const bytes) noexcept
+        {
+            if(!memory) return Allocate(bytes);
+
+            Header * const header = HeaderOf(memory);
+            std::size_t const size = static_cast<std::size_t>(Roundup(bytes));
+
+            // still fits in the block
+            if(header->Class != Classes && size <= header->Size) return memory;
+
+            void * const moved = Allocate(bytes);
+            if(!moved) return nullptr;
+
+            std::memcpy(moved, memory, std::min(header->Size, size));
+            Free(memory);
+            return moved;
+        }
+
+        static int Size(void * const memory) noexcept
+        {
+            return memory ? static_cast<int>(HeaderOf(memory)->Size) : 0;
+        }
+
+        static int Roundup(int const bytes) noexcept
+        {
+            auto const size = static_cast<std::size_t>(bytes > 0 ? bytes : 1);
+            if(size <= Largest)
+            {
+                return static_cast<int>(Smallest << ClassOf(size));
+            }
+            return static_cast<int>((size + 7) & ~std::size_t(7));
+        }
+};
+
+// pages for every page cache come from one buffer of the given number of pages,
+// sqlite falls back to malloc when it runs out
+inline void ConfigurePageCache(int const pageSize, int const pages)
+{
+    int header = 0;
+    CheckConfiguration(sqlite3_config(SQLITE_CONFIG_PCACHE_HDRSZ, &header), "the page cache");
+
+    int const slot = pageSize + header;
+    // lives as long as the process, sqlite may use it until sqlite3_shutdown
+    static std::unique_ptr<unsigned char[]> buffer;
+    std::unique_ptr<unsigned char[]> memory(new unsigned char[static_cast<std::size_t>(slot) * pages]);
+
+    CheckConfiguration(sqlite3_config(SQLITE_CONFIG_PAGECACHE, memory.get(), slot, pages), "the page cache");
+    buffer = std::move(memory);
+}
+
+// a fixed arena for every allocation, only in builds with SQLITE_ENABLE_MEMSYS5
+inline void ConfigureHeap(std::size_t const bytes, int const smallest = 64)
+{
+    static std::unique_ptr<unsigned char[]> buffer;
+    std::unique_ptr<unsigned char[]> memory(new unsigned char[bytes]);
+
+    CheckConfiguration(sqlite3_config(SQLITE_CONFIG_HEAP, memory.get(), static_cast<int>(bytes), smallest), "the heap");
+    buffer = std::move(memory);
+}
+
+// lookaside default of new connections, Connection::SetLookaside changes one of them
+inline void ConfigureLookaside(int const slotSize, int const slots)
+{
+    CheckConfiguration(sqlite3_config(SQLITE_CONFIG_LOOKASIDE, slotSize, slots), "the lookaside");
+}
+
+// without memory statistics sqlite takes no global mutex on each allocation,
+// sqlite3_status then reports no memory usage
+inline void DisableMemoryStatus()
+{
+    CheckConfiguration(sqlite3_config(SQLITE_CONFIG_MEMSTATUS, 0), "the memory status");
+}
+
+/*
+ * MEMORY STATUS AND LIMITS
+ * What sqlite holds in the whole process and in each connection, and limits
+ * that keep it from growing without bound:
+ *
+ *     MemoryGovernor governor({.SoftLimit = 256 << 20, .HardLimit = 512 << 20});
+ *     governor.Add(connection);
+ *     ...
+ *     // between two uses of the connections, on the threads that use them
+ *     governor.Relieve();
+ *
+ * Above the soft limit the page caches recycle their pages instead of growing,
+ * above the hard limit allocations fail with SQLITE_NOMEM. Both need the
+ * memory status that DisableMemoryStatus turns off.
+ * */
+
+// every value since the process started, or since the highest ones were last reset
+struct MemoryStatus
+{
+    long long Used = 0;
+    long long HighestUsed = 0;
+    long long Allocations = 0;
+    long long LargestAllocation = 0;
+    // pages taken from the ConfigurePageCache buffer, and bytes allocated when it ran out
+    long long PageCacheUsed = 0;
+    long long PageCacheOverflow = 0;
+    long long SoftLimit = 0;
+    long long HardLimit = 0;
+};
+
+struct ConnectionMemoryStatus
+{
+    // bytes of the page caches of the connection, shared caches split between their users
+    int CacheUsed = 0;
+    int CacheUsedShared = 0;
+    int CacheHits = 0;
+    int CacheMisses = 0;
+    int CacheWrites = 0;
+    // dirty pages written before commit because the cache was full
+    int CacheSpills = 0;
+    int LookasideUsed = 0;
+    int LookasideHighest = 0;
+    int LookasideHits = 0;
+    int LookasideMissSize = 0;
+    int LookasideMissFull = 0;
+    // bytes of the parsed schema and of the prepared statements
+    int SchemaUsed = 0;
+    int StatementUsed = 0;
+};
+
+// sqlite3_hard_heap_limit64 is there since 3.31
+inline long long HardHeapLimit(long long const bytes)
+{
+#if SQLITE_VERSION_NUMBER >= 3031000
+    return sqlite3_hard_heap_limit64(bytes);
+#else
+    if(bytes < 0) return 0;
+    throw Exception(SQLITE_MISUSE, "hard heap limits need sqlite 3.31 or later");
+#endif
+}
+
+// resetHighest starts the highest values again from the current ones
+inline MemoryStatus GetMemoryStatus(bool const resetHighest = false) noexcept
+{
+    MemoryStatus status;
+    sqlite3_int64 current = 0;
+    sqlite3_int64 highest = 0;
+
+    sqlite3_status64(SQLITE_STATUS_MEMORY_USED, &current, &highest, resetHighest);
+    status.Used = current;
+    status.HighestUsed = highest;
+    sqlite3_status64(SQLITE_STATUS_MALLOC_COUNT, &current, &highest, resetHighest);
+    status.Allocations = current;
+    sqlite3_status64(SQLITE_STATUS_MALLOC_SIZE, &current, &highest, resetHighest);
+    status.LargestAllocation = highest;
+    sqlite3_status64(SQLITE_STATUS_PAGECACHE_USED, &current, &highest, resetHighest);
+    status.PageCacheUsed = current;
+    sqlite3_status64(SQLITE_STATUS_PAGECACHE_OVERFLOW, &current, &highest, resetHighest);
+    status.PageCacheOverflow = current;
+
+    // a negative limit only reads it
+    status.SoftLimit = sqlite3_soft_heap_limit64(-1);
+#if SQLITE_VERSION_NUMBER >= 3031000
+    status.HardLimit = sqlite3_hard_heap_limit64(-1);
+#endif
+    return status;
+}
+
+// resetCounters starts hits, misses, writes, spills and the lookaside counts again
+inline ConnectionMemoryStatus GetMemoryStatus(Connection const & connection, bool const resetCounters = false) noexcept
+{
+    ConnectionMemoryStatus status;
+    int highest = 0;
+
+    auto const read = [&](int const what, int & current)
+    {
+        sqlite3_db_status(connection.GetAbi(), what, &current, &highest, resetCounters);
+        return highest;
+    };
+
+    read(SQLITE_DBSTATUS_CACHE_USED, status.CacheUsed);
+    read(SQLITE_DBSTATUS_CACHE_USED_SHARED, status.CacheUsedShared);
+    read(SQLITE_DBSTATUS_CACHE_HIT, status.CacheHits);
+    read(SQLITE_DBSTATUS_CACHE_MISS, status.CacheMisses);
+    read(SQLITE_DBSTATUS_CACHE_WRITE, status.CacheWrites);
+#ifdef SQLITE_DBSTATUS_CACHE_SPILL
+    read(SQLITE_DBSTATUS_CACHE_SPILL, status.CacheSpills);
+#endif
+    status.LookasideHighest = read(SQLITE_DBSTATUS_LOOKASIDE_USED, status.LookasideUsed);
+    // these three count in their highest value
+    int unused = 0;
+    status.LookasideHits = read(SQLITE_DBSTATUS_LOOKASIDE_HIT, unused);
+    status.LookasideMissSize = read(SQLITE_DBSTATUS_LOOKASIDE_MISS_SIZE, unused);
+    status.LookasideMissFull = read(SQLITE_DBSTATUS_LOOKASIDE_MISS_FULL, unused);
+    read(SQLITE_DBSTATUS_SCHEMA_USED, status.SchemaUsed);
+    read(SQLITE_DBSTATUS_STMT_USED, status.StatementUsed);
+    return status;
+}
+
+struct MemoryGovernorOptions
+{
+    // bytes, 0 leaves the limit the application had in place
+    long long SoftLimit = 0;
+    long long HardLimit = 0;
+    // Relieve frees cache memory once this fraction of the lowest limit is in use
+    double Pressure = 0.8;
+};
+
+struct MemoryGovernorStats
+{
+    // Relieve calls that found pressure, and the bytes they gave back
+    unsigned long long Reliefs = 0;
+    long long Released = 0;
+};
+
+/*
+ * Sets the limits for as long as it lives and frees the unused page cache
+ * memory of the connections added to it when the process gets close to them.
+ * sqlite3_db_release_memory uses a connection, so Relieve runs on the thread
+ * that uses the connections, while none of them is stepping a statement.
+ * */
+class MemoryGovernor
+{
+        MemoryGovernorOptions m_options;
+        long long m_previousSoft = 0;
+        long long m_previousHard = 0;
+        std::vector<Connection const *> m_connections;
+        MemoryGovernorStats m_stats;
+
+        long long Threshold() const noexcept
+        {
+            long long limit = m_options.SoftLimit;
+            if(m_options.HardLimit > 0 && (limit <= 0 || m_options.HardLimit < limit)) limit = m_options.HardLimit;
+            return limit > 0 ? static_cast<long long>(limit * m_options.Pressure) : 0;
+        }
+
+        long long Release(Connection const & connection) noexcept
+        {
+            long long const before = sqlite3_memory_used();
+            sqlite3_db_release_memory(connection.GetAbi());
+            return std::max(0LL, before - static_cast<long long>(sqlite3_memory_used()));
+        }
+
+    public:
+        explicit MemoryGovernor(MemoryGovernorOptions const & options) :
+        m_options{options}
+        {
+            // read before the hard limit is set, it lowers a soft limit above it
+            m_previousSoft = sqlite3_soft_heap_limit64(-1);
+            // the hard limit first, the soft one can not be set above it
+            if(m_options.HardLimit > 0) m_previousHard = HardHeapLimit(m_options.HardLimit);
+            if(m_options.SoftLimit > 0) sqlite3_soft_heap_limit64(m_options.SoftLimit);
+        }
+
+        MemoryGovernor(MemoryGovernor const &) = delete;
+        MemoryGovernor & operator=(MemoryGovernor const &) = delete;
+
+        ~MemoryGovernor() noexcept
+        {
+            // the hard limit first, as in the constructor, it may lower the soft one
+#if SQLITE_VERSION_NUMBER >= 3031000
+            if(m_options.HardLimit > 0) sqlite3_hard_heap_limit64(m_previousHard);
+#endif
+            // a governor that set no limit leaves the ones set while it lived
+            if(m_options.SoftLimit > 0 || m_options.HardLimit > 0) sqlite3_soft_heap_limit64(m_previousSoft);
+        }
+
+        void Add(Connection const & connection)
+        {
+            m_connections.push_back(&connection);
+        }
+
+        void Remove(Connection const & connection) noexcept
+        {
+            m_connections.erase(std::remove(m_connections.begin(), m_connections.end(), &connection), m_connections.end());
+        }
+
+        bool UnderPressure() const noexcept
+        {
+            long long const threshold = Threshold();
+            return threshold > 0 && sqlite3_memory_used() >= threshold;
+        }
+
+        // the caches of the connections added, biggest first, until the pressure is gone;
+        // the bytes given back are returned
+        long long Relieve()
+        {
+            if(!UnderPressure()) return 0;
+
+            std::vector<std::pair<int, Connection const *>> caches;
+            for(Connection const * const connection : m_connections)
+            {
+                caches.emplace_back(GetMemoryStatus(*connection).CacheUsed, connection);
+            }
+            std::sort(caches.begin(), caches.end(), [](auto const & left, auto const & right)
+            {
+                return left.first > right.first;
+            });
+
+            long long released = 0;
+            for(auto const & cache : caches)
+            {
+                if(!UnderPressure()) break;
+                released += Release(*cache.second);
+            }
+
+            ++m_stats.Reliefs;
+            m_stats.Released += released;
+            return released;
+        }
+
+        // one connection, from the thread that uses it, whatever the pressure
+        long long Relieve(Connection const & connection) noexcept
+        {
+            long long const released = Release(connection);
+            m_stats.Released += released;
+            return released;
+        }
+
+        MemoryGovernorStats Stats() const noexcept
+        {
+            return m_stats;
+        }
+};
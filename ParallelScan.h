@@ -0,0 +1,269 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "TacoLite.h"
+
+/*
+ * PARALLEL TABLE SCANS
+ * A table split by rowid, or its integer primary key, into ranges read at the
+ * same time by one read connection and one thread each:
+ *
+ *     ParallelScan scan("analytics.db", "Events");
+ *
+ *     scan.ForEach<Event>("Id, Amount", [](Event const & event, std::size_t partition) { ... });
+ *
+ *     double total = scan.Reduce<double, double>("Amount", 0.0,
+ *             [](double & sum, double const amount) { sum += amount; },
+ *             [](double & total, double const sum) { total += sum; },
+ *             "Amount > 0");
+ *
+ * Every range sees the same committed state of the database. With
+ * SQLITE_ENABLE_SNAPSHOT on a WAL database the readers share an
+ * sqlite3_snapshot. Otherwise a short lived connection holds the write lock
+ * while the readers start their transactions, which needs write access to the file.
+ * */
+
+struct ParallelScanOptions
+{
+    unsigned Partitions = std::thread::hardware_concurrency();
+    ConnectionOptions Open = ConnectionOptions().ReadOnly().NoMutex();
+    // rowid or an integer primary key, the table is split on its values
+    std::string Key = "rowid";
+    // every partition sees the same state, writers may commit in between otherwise
+    bool Consistent = true;
+};
+
+class ParallelScan
+{
+        std::string m_filename;
+        std::string m_table;
+        ParallelScanOptions m_options;
+        std::vector<Connection> m_readers;
+
+        // starts the read transaction of a connection
+        static void Touch(Connection const & connection)
+        {
+            Statement touch(connection, "select 1 from sqlite_master limit 1");
+            touch.Step();
+        }
+
+        // every reader in a read transaction on the same state of the database
+        void Begin() const
+        {
+            for(Connection const & reader : m_readers)
+            {
+                Execute(reader, "begin");
+            }
+
+            if(!m_options.Consistent) return;
+
+#ifdef SQLITE_ENABLE_SNAPSHOT
+            // WAL databases only, others fall back to the write lock
+            Touch(m_readers.front());
+            sqlite3_snapshot * snapshot = nullptr;
+            if(SQLITE_OK == sqlite3_snapshot_get(m_readers.front().GetAbi(), "main", &snapshot))
+            {
+                int result = SQLITE_OK;
+                for(std::size_t index = 1; index != m_readers.size() && result == SQLITE_OK; ++index)
+                {
+                    result = sqlite3_snapshot_open(m_readers[index].GetAbi(), "main", snapshot);
+                }
+                sqlite3_snapshot_free(snapshot);
+
+                if(SQLITE_OK != result)
+                {
+                    throw Exception(result, "the snapshot could not be opened");
+                }
+                return;
+            }
+            for(Connection const & reader : m_readers)
+            {
+                Execute(reader, "rollback");
+                Execute(reader, "begin");
+            }
+#endif
+
+            // no commit can happen while the readers start
+            Connection writer(m_filename.c_str(), ConnectionOptions().NoMutex().BusyTimeout(std::chrono::seconds(5)));
+            Execute(writer, "begin immediate");
+            for(Connection const & reader : m_readers)
+            {
+                Touch(reader);
+            }
+            Execute(writer, "rollback");
+        }
+
+        void End() const noexcept
+        {
+            for(Connection const & reader : m_readers)
+            {
+                if(!sqlite3_get_autocommit(reader.GetAbi()))
+                {
+                    sqlite3_exec(reader.GetAbi(), "rollback", nullptr, nullptr, nullptr);
+                }
+            }
+        }
+
+        // run(partition, first key, last key) on a thread per partition
+        template <typename F>
+        void Run(F run) const
+        {
+            Begin();
+
+            try
+            {
+                std::vector<std::pair<long long, long long>> const ranges = Ranges();
+
+                std::mutex mutex;
+                std::exception_ptr error;
+                std::vector<std::thread> threads;
+
+                for(std::size_t partition = 0; partition != ranges.size(); ++partition)
+                {
+                    threads.emplace_back([&, partition]
+                    {
+                        try
+                        {
+                            run(partition, ranges[partition].first, ranges[partition].second);
+                        }
+                        catch(...)
+                        {
+                            std::lock_guard<std::mutex> lock(mutex);
+                            if(!error) error = std::current_exception();
+                        }
+                    });
+                }
+                for(std::thread & thread : threads)
+                {
+                    thread.join();
+                }
+                if(error) std::rethrow_exception(error);
+            }
+            catch(...)
+            {
+                End();
+                throw;
+            }
+            End();
+        }
+
+        // ranges of keys, inclusive, one per reader at most
+        std::vector<std::pair<long long, long long>> Ranges() const
+        {
+            std::string const key = QuoteName(m_options.Key);
+            Statement bounds(m_readers.front(), ("select min(" + key + "), max(" + key + ") from " + QuoteName(m_table)).c_str());
+            bounds.Step();
+
+            std::vector<std::pair<long long, long long>> ranges;
+            // empty table
+            if(bounds.GetType(0) == Type::Null) return ranges;
+
+            long long const first = bounds.GetInt64(0);
+            long long const last = bounds.GetInt64(1);
+
+            // unsigned, the distance between rowids may not fit a long long
+            auto const distance = static_cast<unsigned long long>(last) - static_cast<unsigned long long>(first);
+            unsigned long long const step = distance / m_readers.size() + 1;
+
+            unsigned long long low = static_cast<unsigned long long>(first);
+            for(std::size_t partition = 0; partition != m_readers.size(); ++partition)
+            {
+                unsigned long long const covered = low - static_cast<unsigned long long>(first);
+                bool const final = partition + 1 == m_readers.size() || distance - covered < step;
+                unsigned long long const high = final ? static_cast<unsigned long long>(last) : low + step - 1;
+
+                ranges.emplace_back(static_cast<long long>(low), static_cast<long long>(high));
+                if(final) break;
+                low = high + 1;
+            }
+            return ranges;
+        }
+
+        std::string Text(char const * const columns, char const * const filter) const
+        {
+            std::string const key = QuoteName(m_options.Key);
+            std::string text = std::string("select ") + columns + " from " + QuoteName(m_table) +
+                    " where " + key + " between ?1 and ?2";
+            if(filter && *filter)
+            {
+                text += std::string(" and (") + filter + ")";
+            }
+            return text;
+        }
+
+    public:
+        ParallelScan(char const * const filename, std::string table, ParallelScanOptions options = ParallelScanOptions()) :
+        m_filename{filename},
+        m_table{std::move(table)},
+        m_options{std::move(options)}
+        {
+            unsigned const partitions = m_options.Partitions ? m_options.Partitions : 1;
+            for(unsigned partition = 0; partition != partitions; ++partition)
+            {
+                m_readers.emplace_back(filename, m_options.Open);
+            }
+        }
+
+        // callback(row, partition) on the thread of every partition for the rows of its range,
+        // columns is the select list and filter an optional where clause
+        template <typename T, typename F>
+        void ForEach(char const * const columns, F callback, char const * const filter = nullptr) const
+        {
+            std::string const text = Text(columns, filter);
+
+            Run([&](std::size_t const partition, long long const first, long long const last)
+            {
+                Statement scan(m_readers[partition], text.c_str(), first, last);
+                CheckColumns<T>(scan.GetAbi());
+
+                while(scan.Step())
+                {
+                    callback(scan.template Read<T>(), partition);
+                }
+            });
+        }
+
+        // accumulate(result, row) into a copy of initial per partition, without locking,
+        // then combine(total, result) for every partition in order
+        template <typename R, typename T, typename F, typename C>
+        R Reduce(char const * const columns, R const initial, F accumulate, C combine,
+                char const * const filter = nullptr) const
+        {
+            // partitions with no range stay empty
+            std::vector<std::optional<R>> results(m_readers.size());
+            std::string const text = Text(columns, filter);
+
+            Run([&](std::size_t const partition, long long const first, long long const last)
+            {
+                Statement scan(m_readers[partition], text.c_str(), first, last);
+                CheckColumns<T>(scan.GetAbi());
+
+                // a local, results of neighbouring partitions share cache lines
+                R result = initial;
+                while(scan.Step())
+                {
+                    accumulate(result, scan.template Read<T>());
+                }
+                results[partition] = std::move(result);
+            });
+
+            std::optional<R> total;
+            for(std::optional<R> & result : results)
+            {
+                if(!result) continue;
+
+                if(total) combine(*total, *result);
+                else total = std::move(result);
+            }
+            return total ? std::move(*total) : initial;
+        }
+};
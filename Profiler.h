@@ -0,0 +1,322 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "TacoLite.h"
+
+/*
+ * STATEMENT PROFILER
+ * Attached to a connection through sqlite3_trace_v2, every finished statement
+ * is recorded under its sql text: a latency histogram and the
+ * sqlite3_stmt_status counters of the run.
+ * SQLITE_TRACE_PROFILE times are only as fine as the clock of the VFS
+ * (milliseconds on unix), so runs are also timed with std::chrono::steady_clock
+ * from their SQLITE_TRACE_STMT event.
+ * sqlite3_trace_v2 replaces the callback installed by Connection::Profile,
+ * and the stmt_status counters of traced statements are reset on every run.
+ * */
+
+// latencies in nanoseconds, four buckets per power of two (within 19%)
+class LatencyHistogram
+{
+        static constexpr unsigned SubBuckets = 4;
+        std::array<unsigned long long, 64 * SubBuckets> m_buckets{};
+
+        static unsigned Bucket(unsigned long long const nanoseconds) noexcept
+        {
+            if(nanoseconds < SubBuckets) return static_cast<unsigned>(nanoseconds);
+
+            unsigned high = 63;
+            while(!((nanoseconds >> high) & 1)) --high;
+
+            // the two bits bellow the highest one pick the sub bucket
+            return high * SubBuckets + static_cast<unsigned>((nanoseconds >> (high - 2)) & (SubBuckets - 1));
+        }
+
+        // largest latency stored in a bucket
+        static unsigned long long UpperBound(unsigned const bucket) noexcept
+        {
+            if(bucket < SubBuckets) return bucket;
+
+            unsigned const high = bucket / SubBuckets;
+            unsigned long long const sub = bucket % SubBuckets;
+            return ((SubBuckets + sub + 1) << (high - 2)) - 1;
+        }
+
+    public:
+        void Add(unsigned long long const nanoseconds) noexcept
+        {
+            ++m_buckets[Bucket(nanoseconds)];
+        }
+
+        // fraction between 0 and 1
+        unsigned long long Percentile(double const fraction, unsigned long long const count) const noexcept
+        {
+            if(!count) return 0;
+
+            auto const target = static_cast<unsigned long long>(fraction * count + 0.5);
+            unsigned long long seen = 0;
+
+            for(unsigned bucket = 0; bucket != m_buckets.size(); ++bucket)
+            {
+                seen += m_buckets[bucket];
+                if(seen >= std::max(target, 1ull)) return UpperBound(bucket);
+            }
+            return UpperBound(static_cast<unsigned>(m_buckets.size() - 1));
+        }
+};
+
+struct StatementProfile
+{
+    std::string Text;
+    unsigned long long Runs = 0;
+
+    // nanoseconds
+    unsigned long long Total = 0;
+    unsigned long long Max = 0;
+    unsigned long long P50 = 0;
+    unsigned long long P99 = 0;
+
+    // sqlite3_stmt_status counters added over every run
+    unsigned long long FullScanSteps = 0;
+    unsigned long long Sorts = 0;
+    unsigned long long AutoIndexes = 0;
+    unsigned long long VmSteps = 0;
+};
+
+class StatementProfiler
+{
+        struct Entry
+        {
+            StatementProfile Profile;
+            LatencyHistogram Histogram;
+        };
+
+        // looking entries up by the sql text of sqlite without building a std::string
+        struct TextHash
+        {
+            using is_transparent = void;
+
+            std::size_t operator()(std::string_view const text) const noexcept
+            {
+                return std::hash<std::string_view>()(text);
+            }
+        };
+
+        using Clock = std::chrono::steady_clock;
+
+        Connection const * m_connection = nullptr;
+        mutable std::mutex m_mutex;
+        std::unordered_map<std::string, Entry, TextHash, std::equal_to<>> m_entries;
+        // statements running right now
+        std::unordered_map<sqlite3_stmt *, Clock::time_point> m_running;
+
+        static int Trace(unsigned const type, void * const context, void * const statement, void * const data) noexcept
+        {
+            auto const profiler = static_cast<StatementProfiler *>(context);
+
+            if(type == SQLITE_TRACE_STMT)
+            {
+                // triggers report their own start with a "--" comment, the statement keeps running
+                if(std::string_view(static_cast<char const *>(data)).substr(0, 2) != "--")
+                {
+                    profiler->Start(static_cast<sqlite3_stmt *>(statement));
+                }
+            }
+            else if(type == SQLITE_TRACE_PROFILE)
+            {
+                profiler->Record(static_cast<sqlite3_stmt *>(statement), *static_cast<sqlite3_int64 const *>(data));
+            }
+            return 0;
+        }
+
+        void Start(sqlite3_stmt * const statement) noexcept
+        {
+            try
+            {
+                auto const now = Clock::now();
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_running[statement] = now;
+            }
+            catch(...)
+            {
+                // out of memory, this run gets the time measured by sqlite
+            }
+        }
+
+        void Record(sqlite3_stmt * const statement, sqlite3_int64 elapsed) noexcept
+        {
+            auto const now = Clock::now();
+
+            char const * const text = sqlite3_sql(statement);
+            if(!text) return;
+
+            // counters of this run only
+            int const fullScanSteps = sqlite3_stmt_status(statement, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1);
+            int const sorts = sqlite3_stmt_status(statement, SQLITE_STMTSTATUS_SORT, 1);
+            int const autoIndexes = sqlite3_stmt_status(statement, SQLITE_STMTSTATUS_AUTOINDEX, 1);
+            int const vmSteps = sqlite3_stmt_status(statement, SQLITE_STMTSTATUS_VM_STEP, 1);
+
+            try
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                auto const started = m_running.find(statement);
+                if(started != m_running.end())
+                {
+                    elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - started->second).count();
+                    m_running.erase(started);
+                }
+                auto const nanoseconds = static_cast<unsigned long long>(elapsed);
+
+                auto found = m_entries.find(std::string_view(text));
+                if(found == m_entries.end())
+                {
+                    found = m_entries.emplace(text, Entry()).first;
+                    found->second.Profile.Text = text;
+                }
+
+                StatementProfile & profile = found->second.Profile;
+                ++profile.Runs;
+                profile.Total += nanoseconds;
+                profile.Max = std::max(profile.Max, nanoseconds);
+                profile.FullScanSteps += fullScanSteps;
+                profile.Sorts += sorts;
+                profile.AutoIndexes += autoIndexes;
+                profile.VmSteps += vmSteps;
+                found->second.Histogram.Add(nanoseconds);
+            }
+            catch(...)
+            {
+                // out of memory, this run is not recorded
+            }
+        }
+
+        static std::string Escape(std::string const & text)
+        {
+            static char const digits[] = "0123456789abcdef";
+
+            std::string escaped;
+            for(char const c : text)
+            {
+                switch(c)
+                {
+                    case '"': escaped += "\\\""; break;
+                    case '\\': escaped += "\\\\"; break;
+                    case '\n': escaped += "\\n"; break;
+                    case '\r': escaped += "\\r"; break;
+                    case '\t': escaped += "\\t"; break;
+                    default:
+                        if(static_cast<unsigned char>(c) < 0x20)
+                        {
+                            // the statement text stays as it was written
+                            escaped += "\\u00";
+                            escaped += digits[static_cast<unsigned char>(c) >> 4];
+                            escaped += digits[c & 15];
+                        }
+                        else
+                        {
+                            escaped += c;
+                        }
+                }
+            }
+            return escaped;
+        }
+
+    public:
+        explicit StatementProfiler(Connection const & connection) :
+        m_connection{&connection}
+        {
+            if(SQLITE_OK != sqlite3_trace_v2(connection.GetAbi(), SQLITE_TRACE_STMT | SQLITE_TRACE_PROFILE, Trace, this))
+            {
+                connection.ThrowLastError();
+            }
+        }
+
+        StatementProfiler(StatementProfiler const &) = delete;
+        StatementProfiler & operator=(StatementProfiler const &) = delete;
+
+        ~StatementProfiler() noexcept
+        {
+            sqlite3_trace_v2(m_connection->GetAbi(), 0, nullptr, nullptr);
+        }
+
+        // every statement seen so far, the most expensive first
+        std::vector<StatementProfile> Snapshot() const
+        {
+            std::vector<StatementProfile> profiles;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                profiles.reserve(m_entries.size());
+
+                for(auto const & entry : m_entries)
+                {
+                    StatementProfile profile = entry.second.Profile;
+                    profile.P50 = std::min(entry.second.Histogram.Percentile(0.50, profile.Runs), profile.Max);
+                    profile.P99 = std::min(entry.second.Histogram.Percentile(0.99, profile.Runs), profile.Max);
+                    profiles.push_back(std::move(profile));
+                }
+            }
+
+            std::sort(profiles.begin(), profiles.end(), [](StatementProfile const & left, StatementProfile const & right)
+            {
+                return left.Total > right.Total;
+            });
+            return profiles;
+        }
+
+        void Reset()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            // statements running now are still timed
+            m_entries.clear();
+        }
+
+        // one line per statement, times in microseconds
+        std::string Text() const
+        {
+            std::string text;
+            char line[192];
+
+            for(StatementProfile const & profile : Snapshot())
+            {
+                std::snprintf(line, sizeof(line), "%10llu runs %12.1f us total %9.1f p50 %9.1f p99 %9.1f max "
+                        "%8llu scans %6llu sorts %4llu autoindex %10llu vm steps  ",
+                        profile.Runs, profile.Total / 1e3, profile.P50 / 1e3, profile.P99 / 1e3, profile.Max / 1e3,
+                        profile.FullScanSteps, profile.Sorts, profile.AutoIndexes, profile.VmSteps);
+                text += line;
+                text += profile.Text;
+                text += '\n';
+            }
+            return text;
+        }
+
+        std::string Json() const
+        {
+            std::string json = "[";
+            char numbers[320];
+
+            for(StatementProfile const & profile : Snapshot())
+            {
+                if(json.size() > 1) json += ",";
+                json += "\n  {\"sql\": \"" + Escape(profile.Text) + "\"";
+                std::snprintf(numbers, sizeof(numbers), ", \"runs\": %llu, \"total_ns\": %llu, \"p50_ns\": %llu, "
+                        "\"p99_ns\": %llu, \"max_ns\": %llu, \"fullscan_steps\": %llu, \"sorts\": %llu, "
+                        "\"autoindexes\": %llu, \"vm_steps\": %llu}",
+                        profile.Runs, profile.Total, profile.P50, profile.P99, profile.Max,
+                        profile.FullScanSteps, profile.Sorts, profile.AutoIndexes, profile.VmSteps);
+                json += numbers;
+            }
+            json += "\n]\n";
+            return json;
+        }
+};
@@ -0,0 +1,488 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "TacoLite.h"
+
+/*
+ * EXPORTING RESULTS
+ * Rows of a statement formatted straight into one reusable buffer, numbers with
+ * std::to_chars, and handed to a sink in big chunks, so memory stays the same
+ * whatever the size of the result:
+ *
+ *     Statement query(connection, "select Id, Name, Score from Users");
+ *     ExportFile(query, "users.jsonl", ExportFormat::JsonLines);
+ *
+ *     Export(query, [&](std::string_view chunk) { socket.Send(chunk); }, ExportFormat::Csv);
+ *
+ * Csv
+ *     RFC 4180, records end with CRLF, a header line with the column names, null
+ *     is an empty field and blobs are written in hex.
+ * JsonLines
+ *     one object per row named by the columns, blobs are hex strings and
+ *     infinities are written as 1e999 like the sqlite json functions do.
+ * Binary
+ *     "TLR1", the column count and the column names, then every cell of every row
+ *     as its sqlite type code (1 byte) followed by
+ *         integer  zigzag varint
+ *         float    8 bytes, IEEE 754 little endian
+ *         text     varint length and UTF-8 bytes
+ *         blob     varint length and bytes
+ *         null     nothing
+ *     counts and lengths are unsigned LEB128 varints.
+ * */
+
+enum class ExportFormat
+{
+        Csv,
+        JsonLines,
+        Binary,
+};
+
+struct ExportOptions
+{
+    ExportFormat Format = ExportFormat::Csv;
+    // csv only
+    char Delimiter = ',';
+    bool Header = true;
+    // bytes gathered before the sink is called
+    std::size_t BufferSize = 1024 * 1024;
+};
+
+struct ExportStats
+{
+    unsigned long long Rows = 0;
+    unsigned long long Bytes = 0;
+    double Seconds = 0;
+
+    double MegabytesPerSecond() const noexcept
+    {
+        return Seconds > 0 ? Bytes / Seconds / (1024 * 1024) : 0;
+    }
+};
+
+// writes every chunk whole to a file descriptor, which it does not own
+class DescriptorSink
+{
+        int m_descriptor;
+
+    public:
+        explicit DescriptorSink(int const descriptor) noexcept :
+        m_descriptor{descriptor}
+        {}
+
+        void operator()(std::string_view chunk) const
+        {
+            while(!chunk.empty())
+            {
+#ifdef _WIN32
+                int const written = _write(m_descriptor, chunk.data(),
+                        static_cast<unsigned>(std::min<std::size_t>(chunk.size(), 1u << 30)));
+#else
+                ssize_t const written = write(m_descriptor, chunk.data(), chunk.size());
+                // interrupted before anything was written
+                if(written < 0 && errno == EINTR) continue;
+#endif
+                if(written < 0)
+                {
+                    throw Exception(SQLITE_IOERR_WRITE, "export write failed: " + std::string(std::strerror(errno)));
+                }
+                chunk.remove_prefix(static_cast<std::size_t>(written));
+            }
+        }
+};
+
+template <typename F>
+class ResultExporter
+{
+        F & m_sink;
+        ExportOptions m_options;
+        std::vector<char> m_buffer;
+        std::size_t m_used = 0;
+        ExportStats m_stats;
+
+        void Flush()
+        {
+            if(!m_used) return;
+            m_sink(std::string_view(m_buffer.data(), m_used));
+            m_stats.Bytes += m_used;
+            m_used = 0;
+        }
+
+        // room for size more bytes, flushing first when they do not fit
+        char * Reserve(std::size_t const size)
+        {
+            if(m_buffer.size() - m_used < size) Flush();
+            return m_buffer.data() + m_used;
+        }
+
+        void Put(char const c)
+        {
+            *Reserve(1) = c;
+            ++m_used;
+        }
+
+        void Put(std::string_view const text)
+        {
+            if(text.size() > m_buffer.size())
+            {
+                // a value larger than the buffer goes to the sink as it is
+                Flush();
+                m_sink(text);
+                m_stats.Bytes += text.size();
+                return;
+            }
+            std::memcpy(Reserve(text.size()), text.data(), text.size());
+            m_used += text.size();
+        }
+
+        template <typename N>
+        void PutNumber(N const value)
+        {
+            // enough for any long long or shortest double
+            char * const begin = Reserve(32);
+            auto [end, error] = std::to_chars(begin, begin + 32, value);
+
+            // a REAL keeps looking like one, 1000.0 is not written as the INTEGER 1000
+            if constexpr (std::is_floating_point_v<N>)
+            {
+                if(std::find_if(begin, end, [](char const c) { return c == '.' || c == 'e' || c == 'n'; }) == end)
+                {
+                    *end++ = '.';
+                    *end++ = '0';
+                }
+            }
+            m_used += end - begin;
+        }
+
+        void PutVarint(unsigned long long value)
+        {
+            char * const begin = Reserve(10);
+            char * end = begin;
+            while(value >= 0x80)
+            {
+                *end++ = static_cast<char>(value | 0x80);
+                value >>= 7;
+            }
+            *end++ = static_cast<char>(value);
+            m_used += end - begin;
+        }
+
+        void PutHex(std::span<std::byte const> const bytes)
+        {
+            static char const digits[] = "0123456789abcdef";
+            for(std::byte const b : bytes)
+            {
+                char * const out = Reserve(2);
+                out[0] = digits[std::to_integer<unsigned>(b) >> 4];
+                out[1] = digits[std::to_integer<unsigned>(b) & 15];
+                m_used += 2;
+            }
+        }
+
+        void PutCsvText(std::string_view const text)
+        {
+            char const special[] = {m_options.Delimiter, '"', '\r', '\n'};
+            if(text.find_first_of(std::string_view(special, 4)) == std::string_view::npos)
+            {
+                Put(text);
+                return;
+            }
+
+            Put('"');
+            std::size_t start = 0;
+            for(std::size_t quote; (quote = text.find('"', start)) != std::string_view::npos; start = quote + 1)
+            {
+                // the quote is written twice
+                Put(text.substr(start, quote + 1 - start));
+                Put('"');
+            }
+            Put(text.substr(start));
+            Put('"');
+        }
+
+        // put(std::string_view) for the quoted and escaped text
+        template <typename P>
+        static void EscapeJson(std::string_view const text, P put)
+        {
+            put("\"");
+            std::size_t start = 0;
+            for(std::size_t index = 0; index != text.size(); ++index)
+            {
+                auto const c = static_cast<unsigned char>(text[index]);
+                if(c >= 0x20 && c != '"' && c != '\\') continue;
+
+                // runs of plain characters are copied at once
+                put(text.substr(start, index - start));
+                start = index + 1;
+
+                switch(c)
+                {
+                    case '"': put("\\\""); break;
+                    case '\\': put("\\\\"); break;
+                    case '\n': put("\\n"); break;
+                    case '\r': put("\\r"); break;
+                    case '\t': put("\\t"); break;
+                    default:
+                    {
+                        static char const digits[] = "0123456789abcdef";
+                        char const escaped[] = {'\\', 'u', '0', '0', digits[c >> 4], digits[c & 15]};
+                        put(std::string_view(escaped, 6));
+                    }
+                }
+            }
+            put(text.substr(start));
+            put("\"");
+        }
+
+        void PutJsonText(std::string_view const text)
+        {
+            EscapeJson(text, [this](std::string_view const part) { Put(part); });
+        }
+
+        static std::string_view Text(sqlite3_stmt * const statement, int const column) noexcept
+        {
+            auto const text = reinterpret_cast<char const *>(sqlite3_column_text(statement, column));
+            return {text ? text : "", static_cast<std::size_t>(sqlite3_column_bytes(statement, column))};
+        }
+
+        static std::span<std::byte const> Blob(sqlite3_stmt * const statement, int const column) noexcept
+        {
+            auto const blob = static_cast<std::byte const *>(sqlite3_column_blob(statement, column));
+            return {blob, static_cast<std::size_t>(sqlite3_column_bytes(statement, column))};
+        }
+
+        void CsvRow(sqlite3_stmt * const statement, int const columns)
+        {
+            for(int column = 0; column != columns; ++column)
+            {
+                if(column) Put(m_options.Delimiter);
+
+                switch(sqlite3_column_type(statement, column))
+                {
+                    case SQLITE_INTEGER: PutNumber(sqlite3_column_int64(statement, column)); break;
+                    case SQLITE_FLOAT: PutNumber(sqlite3_column_double(statement, column)); break;
+                    case SQLITE_TEXT: PutCsvText(Text(statement, column)); break;
+                    case SQLITE_BLOB: PutHex(Blob(statement, column)); break;
+                    default: break;
+                }
+            }
+            Put("\r\n");
+        }
+
+        void JsonRow(sqlite3_stmt * const statement, std::vector<std::string> const & keys)
+        {
+            for(int column = 0; column != static_cast<int>(keys.size()); ++column)
+            {
+                Put(keys[column]);
+
+                switch(sqlite3_column_type(statement, column))
+                {
+                    case SQLITE_INTEGER: PutNumber(sqlite3_column_int64(statement, column)); break;
+                    case SQLITE_FLOAT:
+                    {
+                        double const value = sqlite3_column_double(statement, column);
+                        if(std::isinf(value)) Put(value < 0 ? "-1e999" : "1e999");
+                        else PutNumber(value);
+                        break;
+                    }
+                    case SQLITE_TEXT: PutJsonText(Text(statement, column)); break;
+                    case SQLITE_BLOB:
+                        Put('"');
+                        PutHex(Blob(statement, column));
+                        Put('"');
+                        break;
+                    default: Put("null"); break;
+                }
+            }
+            Put(keys.empty() ? "{}\n" : "}\n");
+        }
+
+        void BinaryRow(sqlite3_stmt * const statement, int const columns)
+        {
+            for(int column = 0; column != columns; ++column)
+            {
+                int const type = sqlite3_column_type(statement, column);
+                Put(static_cast<char>(type));
+
+                switch(type)
+                {
+                    case SQLITE_INTEGER:
+                    {
+                        auto const value = static_cast<unsigned long long>(sqlite3_column_int64(statement, column));
+                        // small negative numbers stay short
+                        PutVarint((value << 1) ^ (0 - (value >> 63)));
+                        break;
+                    }
+                    case SQLITE_FLOAT:
+                    {
+                        auto bits = std::bit_cast<std::uint64_t>(sqlite3_column_double(statement, column));
+                        char * const out = Reserve(8);
+                        for(int index = 0; index != 8; ++index, bits >>= 8)
+                        {
+                            out[index] = static_cast<char>(bits & 0xff);
+                        }
+                        m_used += 8;
+                        break;
+                    }
+                    case SQLITE_TEXT:
+                    {
+                        std::string_view const text = Text(statement, column);
+                        PutVarint(text.size());
+                        Put(text);
+                        break;
+                    }
+                    case SQLITE_BLOB:
+                    {
+                        auto const blob = Blob(statement, column);
+                        PutVarint(blob.size());
+                        Put(std::string_view(reinterpret_cast<char const *>(blob.data()), blob.size()));
+                        break;
+                    }
+                    default: break;
+                }
+            }
+        }
+
+    public:
+        ResultExporter(F & sink, ExportOptions const & options) :
+        m_sink{sink},
+        m_options{options},
+        // the widest single write is a number or a varint
+        m_buffer(std::max<std::size_t>(options.BufferSize, 64))
+        {}
+
+        // every remaining row of the statement
+        ExportStats Run(Statement const & statement)
+        {
+            auto const start = std::chrono::steady_clock::now();
+            sqlite3_stmt * const abi = statement.GetAbi();
+            int const columns = sqlite3_column_count(abi);
+
+            std::vector<std::string> keys;
+            if(m_options.Format == ExportFormat::Csv && m_options.Header)
+            {
+                for(int column = 0; column != columns; ++column)
+                {
+                    if(column) Put(m_options.Delimiter);
+                    PutCsvText(sqlite3_column_name(abi, column));
+                }
+                Put("\r\n");
+            }
+            else if(m_options.Format == ExportFormat::JsonLines)
+            {
+                // the escaped names with their punctuation, once for every row
+                for(int column = 0; column != columns; ++column)
+                {
+                    std::string & key = keys.emplace_back(column ? "," : "{");
+                    EscapeJson(sqlite3_column_name(abi, column), [&](std::string_view const part) { key += part; });
+                    key += ':';
+                }
+            }
+            else if(m_options.Format == ExportFormat::Binary)
+            {
+                Put("TLR1");
+                PutVarint(static_cast<unsigned>(columns));
+                for(int column = 0; column != columns; ++column)
+                {
+                    std::string_view const name = sqlite3_column_name(abi, column);
+                    PutVarint(name.size());
+                    Put(name);
+                }
+            }
+
+            while(statement.Step())
+            {
+                switch(m_options.Format)
+                {
+                    case ExportFormat::Csv: CsvRow(abi, columns); break;
+                    case ExportFormat::JsonLines: JsonRow(abi, keys); break;
+                    case ExportFormat::Binary: BinaryRow(abi, columns); break;
+                }
+                ++m_stats.Rows;
+            }
+            Flush();
+
+            m_stats.Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            return m_stats;
+        }
+};
+
+// sink(std::string_view) is called with chunks of about BufferSize bytes
+template <typename F>
+ExportStats Export(Statement const & statement, F sink, ExportOptions const & options = ExportOptions())
+{
+    return ResultExporter<F>(sink, options).Run(statement);
+}
+
+template <typename F>
+ExportStats Export(Statement const & statement, F sink, ExportFormat const format)
+{
+    ExportOptions options;
+    options.Format = format;
+    return Export(statement, std::move(sink), options);
+}
+
+// the file is created or truncated
+inline ExportStats ExportFile(Statement const & statement, char const * const filename,
+        ExportOptions const & options = ExportOptions())
+{
+    struct DescriptorTraits
+    {
+        using Type = int;
+
+        static Type Invalid() noexcept
+        {
+            return -1;
+        }
+
+        static void Close(Type value) noexcept
+        {
+#ifdef _WIN32
+            VERIFY_(0, _close(value));
+#else
+            VERIFY_(0, close(value));
+#endif
+        }
+    };
+
+#ifdef _WIN32
+    Handle<DescriptorTraits> file(_open(filename, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE));
+#else
+    Handle<DescriptorTraits> file(open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644));
+#endif
+    if(!file)
+    {
+        throw Exception(SQLITE_CANTOPEN, std::string("can not create ") + filename);
+    }
+    return Export(statement, DescriptorSink(file.Get()), options);
+}
+
+inline ExportStats ExportFile(Statement const & statement, char const * const filename, ExportFormat const format)
+{
+    ExportOptions options;
+    options.Format = format;
+    return ExportFile(statement, filename, options);
+}
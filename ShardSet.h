@@ -0,0 +1,488 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "AsyncQuery.h"
+#include "TacoLite.h"
+
+/*
+ * SHARDED DATABASES
+ * One connection per shard file, the same query runs on every shard at once on
+ * the threads of an AsyncPool and the rows come back through one iterator:
+ *
+ *     ShardSet shards({"orders-0.db", "orders-1.db", "orders-2.db"});
+ *
+ *     for(Order const & order : shards.Query<Order>("select Id, Amount from Orders where Amount > ?", 100))
+ *
+ *     // every shard sorted on the key, merged in order
+ *     for(Order const & order : shards.Merge<Order>([](Order const & order) { return order.Id; },
+ *             "select Id, Amount from Orders order by Id"))
+ *
+ *     // partial aggregates of every shard combined
+ *     Totals totals = shards.Reduce<Totals>(Totals{}, [](Totals & total, Totals const & part)
+ *     {
+ *         total.Count += part.Count;
+ *         total.Amount += part.Amount;
+ *     }, "select count(*), sum(Amount) from Orders");
+ *
+ * Rows travel in batches. A shard stops reading, without holding a thread,
+ * once the iterator is a few batches behind it.
+ * */
+
+struct ShardOptions
+{
+    // every shard connection is only used by one thread at a time
+    ConnectionOptions Open = ConnectionOptions().NoMutex();
+    unsigned Threads = std::thread::hardware_concurrency();
+    std::size_t BatchRows = 256;
+    // batches waiting per shard before it stops reading
+    std::size_t QueuedBatches = 4;
+};
+
+struct Shard
+{
+    Connection Database;
+    // held while a thread uses the connection
+    std::mutex Mutex;
+};
+
+// rows of a query on every shard, decoded through RowTraits<T>
+template <typename T>
+class ShardQuery
+{
+        struct Cursor
+        {
+            Statement Query;
+            std::deque<std::vector<T>> Batches;
+            bool Done = false;
+            // the queue was full, the consumer posts the shard again
+            bool Parked = false;
+        };
+
+        AsyncPool * m_pool = nullptr;
+        std::span<std::unique_ptr<Shard> const> m_shards;
+        std::string m_text;
+        std::function<void(Statement const &)> m_bind;
+        std::size_t m_batchRows = 0;
+        std::size_t m_queuedBatches = 0;
+        // orders the rows of a merge, empty when shards are read as they come
+        std::function<bool(T const &, T const &)> m_less;
+
+        std::mutex m_mutex;
+        std::condition_variable m_changed;
+        std::vector<Cursor> m_cursors;
+        // shards posted to the pool and not finished
+        std::size_t m_running = 0;
+        bool m_cancelled = false;
+        std::exception_ptr m_error;
+
+        // consumer side
+        std::vector<T> m_batch;
+        std::size_t m_position = 0;
+        std::size_t m_next = 0;
+        std::vector<std::vector<T>> m_heads;
+        std::vector<std::size_t> m_positions;
+        std::vector<std::size_t> m_heap;
+        std::size_t m_last = 0;
+        bool m_started = false;
+
+        void Post(std::size_t const index)
+        {
+            m_pool->Post([this, index] { Produce(index); });
+        }
+
+        // one batch of a shard, on a thread of the pool
+        void Produce(std::size_t const index) noexcept
+        {
+            std::vector<T> batch;
+            bool finished = false;
+            std::exception_ptr error;
+
+            try
+            {
+                Shard & shard = *m_shards[index];
+                std::lock_guard<std::mutex> lock(shard.Mutex);
+                Statement & query = m_cursors[index].Query;
+
+                if(!query)
+                {
+                    query.Prepare(shard.Database, m_text.c_str());
+                    m_bind(query);
+                    CheckColumns<T>(query.GetAbi());
+                }
+
+                batch.reserve(m_batchRows);
+                while(batch.size() != m_batchRows)
+                {
+                    if(!query.Step())
+                    {
+                        finished = true;
+                        break;
+                    }
+                    batch.push_back(query.template Read<T>());
+                }
+
+                // the read transaction of the shard ends here
+                if(finished) query = Statement();
+            }
+            catch(...)
+            {
+                error = std::current_exception();
+                finished = true;
+            }
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            Cursor & cursor = m_cursors[index];
+
+            if(error && !m_error) m_error = error;
+            if(!batch.empty()) cursor.Batches.push_back(std::move(batch));
+            cursor.Done = finished;
+
+            if(finished || m_cancelled || m_error)
+            {
+                --m_running;
+            }
+            else if(cursor.Batches.size() < m_queuedBatches)
+            {
+                Post(index);
+            }
+            else
+            {
+                cursor.Parked = true;
+                --m_running;
+            }
+            m_changed.notify_all();
+        }
+
+        // the consumer made room in the queue of a parked shard, m_mutex is held
+        void Unpark(std::size_t const index)
+        {
+            Cursor & cursor = m_cursors[index];
+            if(cursor.Parked && !m_cancelled && !m_error)
+            {
+                cursor.Parked = false;
+                ++m_running;
+                Post(index);
+            }
+        }
+
+        // the next batch of one shard, false once the shard is over
+        bool Take(std::size_t const index, std::vector<T> & batch)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            Cursor & cursor = m_cursors[index];
+            m_changed.wait(lock, [&] { return m_error || !cursor.Batches.empty() || cursor.Done; });
+
+            if(m_error) std::rethrow_exception(m_error);
+            if(cursor.Batches.empty()) return false;
+
+            batch = std::move(cursor.Batches.front());
+            cursor.Batches.pop_front();
+            Unpark(index);
+            return true;
+        }
+
+        // the next batch of whichever shard has one, false once every shard is over
+        bool TakeAny(std::vector<T> & batch)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+
+            for(;;)
+            {
+                if(m_error) std::rethrow_exception(m_error);
+
+                bool done = true;
+                for(std::size_t offset = 0; offset != m_cursors.size(); ++offset)
+                {
+                    std::size_t const index = (m_next + offset) % m_cursors.size();
+                    Cursor & cursor = m_cursors[index];
+
+                    if(!cursor.Batches.empty())
+                    {
+                        batch = std::move(cursor.Batches.front());
+                        cursor.Batches.pop_front();
+                        Unpark(index);
+                        // the other shards go first next time
+                        m_next = index + 1;
+                        return true;
+                    }
+                    done = done && cursor.Done;
+                }
+                if(done) return false;
+
+                m_changed.wait(lock);
+            }
+        }
+
+        T * NextUnordered()
+        {
+            while(m_position == m_batch.size())
+            {
+                m_batch.clear();
+                m_position = 0;
+                if(!TakeAny(m_batch)) return nullptr;
+            }
+            return &m_batch[m_position++];
+        }
+
+        bool Fill(std::size_t const index)
+        {
+            m_heads[index].clear();
+            m_positions[index] = 0;
+            return Take(index, m_heads[index]);
+        }
+
+        // k-way merge of the current row of every shard
+        T * NextMerged()
+        {
+            // the smallest row on top of the heap
+            auto const greater = [this](std::size_t const left, std::size_t const right)
+            {
+                return m_less(m_heads[right][m_positions[right]], m_heads[left][m_positions[left]]);
+            };
+
+            if(!m_started)
+            {
+                m_started = true;
+                m_heads.resize(m_cursors.size());
+                m_positions.resize(m_cursors.size());
+
+                for(std::size_t index = 0; index != m_cursors.size(); ++index)
+                {
+                    if(Fill(index)) m_heap.push_back(index);
+                }
+                std::make_heap(m_heap.begin(), m_heap.end(), greater);
+            }
+            else
+            {
+                // the shard of the row handed out last moves on
+                if(++m_positions[m_last] != m_heads[m_last].size() || Fill(m_last))
+                {
+                    m_heap.push_back(m_last);
+                    std::push_heap(m_heap.begin(), m_heap.end(), greater);
+                }
+            }
+
+            if(m_heap.empty()) return nullptr;
+
+            std::pop_heap(m_heap.begin(), m_heap.end(), greater);
+            m_last = m_heap.back();
+            m_heap.pop_back();
+            return &m_heads[m_last][m_positions[m_last]];
+        }
+
+    public:
+        ShardQuery(AsyncPool & pool, std::span<std::unique_ptr<Shard> const> const shards, std::string text,
+                std::function<void(Statement const &)> bind, ShardOptions const & options,
+                std::function<bool(T const &, T const &)> less = nullptr) :
+                m_pool{&pool},
+                m_shards{shards},
+                m_text{std::move(text)},
+                m_bind{std::move(bind)},
+                m_batchRows{options.BatchRows ? options.BatchRows : 1},
+                m_queuedBatches{options.QueuedBatches ? options.QueuedBatches : 1},
+                m_less{std::move(less)},
+                m_cursors(shards.size())
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for(std::size_t index = 0; index != m_cursors.size(); ++index)
+            {
+                ++m_running;
+                Post(index);
+            }
+        }
+
+        // the pool refers to this object
+        ShardQuery(ShardQuery const &) = delete;
+        ShardQuery & operator=(ShardQuery const &) = delete;
+
+        // rows not read yet are dropped, shards still reading stop after their batch
+        ~ShardQuery() noexcept
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cancelled = true;
+                m_changed.wait(lock, [this] { return m_running == 0; });
+            }
+
+            for(std::size_t index = 0; index != m_cursors.size(); ++index)
+            {
+                std::lock_guard<std::mutex> lock(m_shards[index]->Mutex);
+                m_cursors[index].Query = Statement();
+            }
+        }
+
+        // nullptr after the last row, the row is valid until the next call
+        T * Next()
+        {
+            return m_less ? NextMerged() : NextUnordered();
+        }
+
+        class Iterator
+        {
+                ShardQuery * m_query = nullptr;
+                T * m_row = nullptr;
+
+            public:
+                Iterator() noexcept = default;
+
+                explicit Iterator(ShardQuery * const query) :
+                m_query{query},
+                m_row{query->Next()}
+                {}
+
+                Iterator & operator++()
+                {
+                    m_row = m_query->Next();
+                    return *this;
+                }
+
+                bool operator!=(Iterator const & other) const noexcept
+                {
+                    return m_row != other.m_row;
+                }
+
+                T & operator*() const noexcept
+                {
+                    return *m_row;
+                }
+        };
+
+        // a single pass, like RowIterator
+        Iterator begin()
+        {
+            return Iterator(this);
+        }
+
+        Iterator end() noexcept
+        {
+            return Iterator();
+        }
+};
+
+class ShardSet
+{
+        // before the pool, whose threads are joined first
+        std::vector<std::unique_ptr<Shard>> m_shards;
+        ShardOptions m_options;
+        AsyncPool m_pool;
+
+        template <typename ... Values>
+        static std::function<void(Statement const &)> Binder(Values && ... values)
+        {
+            return [values = StoredValues<Values ...>(std::forward<Values>(values)...)](Statement const & statement)
+            {
+                std::apply([&](auto const & ... stored)
+                {
+                    statement.BindAll(stored ...);
+                }, values);
+            };
+        }
+
+    public:
+        explicit ShardSet(std::vector<std::string> const & filenames, ShardOptions options = ShardOptions()) :
+        m_options{std::move(options)},
+        m_pool{m_options.Threads}
+        {
+            for(std::string const & filename : filenames)
+            {
+                m_shards.push_back(std::make_unique<Shard>());
+                m_shards.back()->Database.Open(filename.c_str(), m_options.Open);
+            }
+        }
+
+        ShardSet(ShardSet const &) = delete;
+        ShardSet & operator=(ShardSet const &) = delete;
+
+        std::size_t Size() const noexcept
+        {
+            return m_shards.size();
+        }
+
+        // rows of every shard in the order they arrive
+        template <typename T, typename ... Values>
+        ShardQuery<T> Query(char const * const text, Values && ... values)
+        {
+            return ShardQuery<T>(m_pool, m_shards, text, Binder(std::forward<Values>(values)...), m_options);
+        }
+
+        // every shard must return its rows sorted on key(row), the result is sorted too
+        template <typename T, typename Key, typename ... Values>
+        ShardQuery<T> Merge(Key key, char const * const text, Values && ... values)
+        {
+            return ShardQuery<T>(m_pool, m_shards, text, Binder(std::forward<Values>(values)...), m_options,
+                    [key = std::move(key)](T const & left, T const & right)
+            {
+                return key(left) < key(right);
+            });
+        }
+
+        // combine(total, row) for the rows of every shard, usually one partial aggregate each
+        template <typename T, typename F, typename ... Values>
+        T Reduce(T total, F combine, char const * const text, Values && ... values)
+        {
+            for(T & row : Query<T>(text, std::forward<Values>(values)...))
+            {
+                combine(total, row);
+            }
+            return total;
+        }
+
+        // work(connection, shard index) on every shard at once, the first error is thrown
+        template <typename F>
+        void ForEach(F work)
+        {
+            std::mutex mutex;
+            std::condition_variable finished;
+            std::size_t running = m_shards.size();
+            std::exception_ptr error;
+
+            for(std::size_t index = 0; index != m_shards.size(); ++index)
+            {
+                m_pool.Post([&, index]
+                {
+                    std::exception_ptr failure;
+                    try
+                    {
+                        std::lock_guard<std::mutex> lock(m_shards[index]->Mutex);
+                        work(static_cast<Connection const &>(m_shards[index]->Database), index);
+                    }
+                    catch(...)
+                    {
+                        failure = std::current_exception();
+                    }
+
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if(failure && !error) error = failure;
+                    if(--running == 0) finished.notify_one();
+                });
+            }
+
+            std::unique_lock<std::mutex> lock(mutex);
+            finished.wait(lock, [&] { return running == 0; });
+            if(error) std::rethrow_exception(error);
+        }
+
+        // the same statement on every shard, such as a schema change
+        template <typename ... Values>
+        void Execute(char const * const text, Values const & ... values)
+        {
+            ForEach([&](Connection const & connection, std::size_t)
+            {
+                ::Execute(connection, text, values ...);
+            });
+        }
+};
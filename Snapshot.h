@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "MappedFile.h"
+#include "TacoLite.h"
+
+/*
+ * DATABASE SNAPSHOTS
+ * A database file loaded whole into a connection with sqlite3_deserialize,
+ * so an in memory database comes up in about the time it takes to map the file:
+ *
+ *     Connection cache = Connection::Memory();
+ *     DeserializeFromFile(cache, "warm.db", SnapshotMode::ReadOnly);
+ *     ...
+ *     SaveSnapshot(cache, "warm.db");
+ *
+ * Any database file is a snapshot, SaveToDisk writes one as well. Commits
+ * still in the -wal file of a WAL database are not part of it until a checkpoint.
+ * */
+
+#ifdef TACOLITE_HAS_DESERIALIZE
+
+enum class SnapshotMode
+{
+        // the mapped file is read in place, pages are loaded when queries touch them
+        ReadOnly,
+        // a copy in memory owned by sqlite, the file is read once
+        Writable,
+};
+
+inline void DeserializeFromFile(Connection & connection, char const * const filename,
+        SnapshotMode const mode = SnapshotMode::ReadOnly, char const * const schema = "main")
+{
+    if(mode == SnapshotMode::Writable)
+    {
+        MappedFile const file(filename);
+        file.Sequential();
+        connection.DeserializeFrom(file.Bytes(), schema);
+        return;
+    }
+
+    // copy on write, clearing a WAL header copies the first page only
+    auto file = std::make_shared<MappedFile>(filename, MapMode::CopyOnWrite);
+    std::span<std::byte> const bytes = file->WritableBytes();
+    if(bytes.size() >= 20 && bytes[18] == std::byte{2} && bytes[19] == std::byte{2})
+    {
+        bytes[18] = std::byte{1};
+        bytes[19] = std::byte{1};
+    }
+    std::span<std::byte const> const view = file->Bytes();
+    connection.DeserializeFrom(view, std::move(file), schema);
+}
+
+// the file is on disk, not only in the cache of the system
+inline void SyncFile(char const * const filename)
+{
+#ifdef _WIN32
+    struct FileHandleTraits : HandleTraits<HANDLE>
+    {
+        static Type Invalid() noexcept
+        {
+            return INVALID_HANDLE_VALUE;
+        }
+
+        static void Close(Type value) noexcept
+        {
+            VERIFY(CloseHandle(value));
+        }
+    };
+
+    Handle<FileHandleTraits> file(CreateFileA(filename, GENERIC_WRITE, 0, nullptr, OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL, nullptr));
+    bool const synced = file && FlushFileBuffers(file.Get());
+#else
+    struct DescriptorTraits
+    {
+        using Type = int;
+
+        static Type Invalid() noexcept
+        {
+            return -1;
+        }
+
+        static void Close(Type value) noexcept
+        {
+            VERIFY_(0, close(value));
+        }
+    };
+
+    Handle<DescriptorTraits> file(open(filename, O_RDWR));
+    bool const synced = file && fsync(file.Get()) == 0;
+#endif
+    if(!synced)
+    {
+        throw Exception(SQLITE_IOERR_FSYNC, std::string("can not sync ") + filename);
+    }
+}
+
+// copied page by page into a file next to filename, synced and renamed over it:
+// a reader or a crash never sees half a snapshot, and the database is never
+// held in memory at once, so it stays within the heap limits of Memory.h
+inline void SaveSnapshot(Connection const & connection, char const * const filename, char const * const schema = "main")
+{
+    std::string const temporary = std::string(filename) + ".tmp";
+    // left by a crash in a previous save
+    std::remove(temporary.c_str());
+    std::remove((temporary + "-journal").c_str());
+
+    try
+    {
+        {
+            Connection destination(temporary.c_str());
+            BackupOptions options;
+            options.Source = schema;
+            IncrementalBackup(destination, connection, options);
+        }
+        SyncFile(temporary.c_str());
+    }
+    catch(...)
+    {
+        std::remove(temporary.c_str());
+        throw;
+    }
+
+#ifdef _WIN32
+    bool const replaced = MoveFileExA(temporary.c_str(), filename, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+    bool const replaced = std::rename(temporary.c_str(), filename) == 0;
+#endif
+    if(!replaced)
+    {
+        std::remove(temporary.c_str());
+        throw Exception(SQLITE_IOERR, "can not replace " + std::string(filename));
+    }
+
+#ifndef _WIN32
+    // the rename itself is durable once the directory is synced, if that fails
+    // the old snapshot or the new one is there after a crash, never half of one
+    std::string directory = std::filesystem::path(filename).parent_path().string();
+    int const entries = open(directory.empty() ? "." : directory.c_str(), O_RDONLY);
+    if(entries != -1)
+    {
+        fsync(entries);
+        close(entries);
+    }
+#endif
+}
+
+#endif
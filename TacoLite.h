@@ -3,7 +3,26 @@
 //
 
 #pragma once
+#include <algorithm>
+#include <chrono>
+#include <concepts>
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <limits>
 #include <string>
+#include <string_view>
+#include <span>
+#include <list>
+#include <thread>
+#include <memory>
+#include <new>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 // imported through conan package manager
 #include "sqlite3.h"
 // resource handler
@@ -29,6 +48,37 @@ enum class Type
         Text = SQLITE_TEXT,
 };
 
+// who keeps bound text and blobs alive until the statement is stepped
+enum class Lifetime
+{
+        // the caller, sqlite only keeps the pointer (SQLITE_STATIC)
+        Static,
+        // sqlite makes its own copy before bind returns (SQLITE_TRANSIENT)
+        Transient,
+};
+
+inline sqlite3_destructor_type Destructor(Lifetime const lifetime) noexcept
+{
+    return lifetime == Lifetime::Static ? SQLITE_STATIC : SQLITE_TRANSIENT;
+}
+
+// a blob of zeros of the given size bound to a statement, room for a BlobStream
+// to write into without ever holding the whole value in memory
+struct ZeroBlob
+{
+    unsigned long long Size = 0;
+};
+
+// a copy of C text bound later, a null pointer stays null instead of becoming text
+template <typename C>
+struct StoredText : std::optional<std::basic_string<C>>
+{
+    StoredText(C const * const text)
+    {
+        if(text) this->emplace(text);
+    }
+};
+
 // Turning error into exceptions
 struct Exception
 {
@@ -38,7 +88,443 @@ struct Exception
     Result(sqlite3_extended_errcode(connection)),
     Message(sqlite3_errmsg(connection))
     {}
+
+    // errors detected by TacoLite itself, not by sqlite
+    Exception(int const result, std::string message) :
+    Result(result),
+    Message(std::move(message))
+    {}
+};
+
+// counting the parameters of a query at compile time, so call sites can do
+// static_assert(ParameterCount("insert into Users values (?, ?)") == 2);
+// only ? and ?NNN are understood, named parameters are not counted
+constexpr int ParameterCount(char const * text) noexcept
+{
+    int count = 0;
+    char quote = 0;
+
+    for(; *text; ++text)
+    {
+        // question marks inside literals or quoted names are not parameters
+        if(quote)
+        {
+            if(*text == quote) quote = 0;
+            continue;
+        }
+        if(*text == '\'' || *text == '"' || *text == '`')
+        {
+            quote = *text;
+            continue;
+        }
+        if(*text != '?') continue;
+
+        if(text[1] < '0' || text[1] > '9')
+        {
+            // anonymous parameter takes the next index
+            ++count;
+            continue;
+        }
+
+        // ?NNN: the count is the largest index used
+        int index = 0;
+        while(text[1] >= '0' && text[1] <= '9')
+        {
+            index = index * 10 + (*++text - '0');
+        }
+        if(index > count) count = index;
+    }
+    return count;
+}
+
+// a table, column or savepoint name pasted into sql text, any character allowed
+inline std::string QuoteName(std::string_view const name)
+{
+    std::string quoted = "\"";
+    for(char const c : name)
+    {
+        if(c == '"') quoted += '"';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+// hits, misses and evictions of the prepared statement cache in a connection
+struct StatementCacheStats
+{
+    unsigned long long Hits = 0;
+    unsigned long long Misses = 0;
+    unsigned long long Evictions = 0;
+    std::size_t Size = 0;
+    std::size_t Capacity = 0;
+};
+
+// limits of the result cache in a connection
+struct ResultCacheOptions
+{
+    // decoded rows kept, least recently used results are dropped first
+    std::size_t MaxBytes = 16 * 1024 * 1024;
+    // pragma data_version before every lookup to notice commits of other connections,
+    // a connection that is the only writer of its database can skip it
+    bool WatchOtherConnections = true;
+    // pragma data_version starts a read transaction, reading it at most this often makes
+    // hits much cheaper but results may miss commits of other connections for that long
+    std::chrono::milliseconds WatchInterval{0};
+};
+
+struct ResultCacheStats
+{
+    unsigned long long Hits = 0;
+    unsigned long long Misses = 0;
+    // results found stale by a change in their tables
+    unsigned long long Invalidations = 0;
+    // results dropped to stay under MaxBytes
+    unsigned long long Evictions = 0;
+    std::size_t Entries = 0;
+    std::size_t Bytes = 0;
+
+    double HitRate() const noexcept
+    {
+        return Hits + Misses ? static_cast<double>(Hits) / (Hits + Misses) : 0;
+    }
+};
+
+// OPEN OPTIONS
+enum class JournalMode
+{
+        Delete,
+        Truncate,
+        Persist,
+        Memory,
+        Wal,
+        Off,
+};
+
+enum class SynchronousMode
+{
+        Off,
+        Normal,
+        Full,
+        Extra,
+};
+
+enum class TempStoreMode
+{
+        Default,
+        File,
+        Memory,
+};
+
+/*
+ * Flags for sqlite3_open_v2 and the pragmas applied right after it, all of them
+ * are in place before Open returns, or the connection is closed again and the
+ * error thrown:
+ *
+ *     Connection connection("app.db", ConnectionOptions::Preset("read-mostly").BusyTimeout(std::chrono::seconds(1)));
+ * */
+class ConnectionOptions
+{
+        int m_flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
+        std::string m_vfs;
+        std::optional<std::chrono::milliseconds> m_busyTimeout;
+        std::optional<JournalMode> m_journal;
+        std::optional<SynchronousMode> m_synchronous;
+        std::optional<long long> m_mmapSize;
+        std::optional<int> m_cacheSize;
+        std::optional<TempStoreMode> m_tempStore;
+        std::optional<std::pair<int, int>> m_lookaside;
+        std::vector<std::pair<std::string, std::string>> m_pragmas;
+
+        static char const * JournalName(JournalMode const mode) noexcept
+        {
+            char const * const names[] = {"delete", "truncate", "persist", "memory", "wal", "off"};
+            return names[static_cast<int>(mode)];
+        }
+
+        static void Run(sqlite3 * const connection, std::string const & text, std::string * const result = nullptr)
+        {
+            auto const first = [](void * const context, int const columns, char ** const values, char **)
+            {
+                if(context && columns && values[0])
+                {
+                    *static_cast<std::string *>(context) = values[0];
+                }
+                return 0;
+            };
+
+            if(SQLITE_OK != sqlite3_exec(connection, text.c_str(), first, result, nullptr))
+            {
+                throw Exception(connection);
+            }
+        }
+
+    public:
+        ConnectionOptions & ReadOnly() noexcept
+        {
+            m_flags = (m_flags & ~(SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE)) | SQLITE_OPEN_READONLY;
+            return *this;
+        }
+
+        ConnectionOptions & ReadWrite(bool const create = true) noexcept
+        {
+            m_flags = (m_flags & ~(SQLITE_OPEN_READONLY | SQLITE_OPEN_CREATE)) | SQLITE_OPEN_READWRITE;
+            if(create) m_flags |= SQLITE_OPEN_CREATE;
+            return *this;
+        }
+
+        // the connection is used by one thread at a time, sqlite skips its own locking
+        ConnectionOptions & NoMutex() noexcept
+        {
+            m_flags = (m_flags & ~SQLITE_OPEN_FULLMUTEX) | SQLITE_OPEN_NOMUTEX;
+            return *this;
+        }
+
+        ConnectionOptions & FullMutex() noexcept
+        {
+            m_flags = (m_flags & ~SQLITE_OPEN_NOMUTEX) | SQLITE_OPEN_FULLMUTEX;
+            return *this;
+        }
+
+        // file: names with query parameters such as file:data.db?mode=ro&cache=shared
+        ConnectionOptions & Uri() noexcept
+        {
+            m_flags |= SQLITE_OPEN_URI;
+            return *this;
+        }
+
+        // any other SQLITE_OPEN_* flag
+        ConnectionOptions & Flags(int const flags) noexcept
+        {
+            m_flags |= flags;
+            return *this;
+        }
+
+        ConnectionOptions & Vfs(std::string name)
+        {
+            m_vfs = std::move(name);
+            return *this;
+        }
+
+        ConnectionOptions & BusyTimeout(std::chrono::milliseconds const timeout) noexcept
+        {
+            m_busyTimeout = timeout;
+            return *this;
+        }
+
+        // throws SQLITE_CANTOPEN when the mode can not be set, in memory databases keep theirs
+        ConnectionOptions & Journal(JournalMode const mode) noexcept
+        {
+            m_journal = mode;
+            return *this;
+        }
+
+        ConnectionOptions & Synchronous(SynchronousMode const mode) noexcept
+        {
+            m_synchronous = mode;
+            return *this;
+        }
+
+        ConnectionOptions & MmapSize(long long const bytes) noexcept
+        {
+            m_mmapSize = bytes;
+            return *this;
+        }
+
+        // like the pragma: pages when positive, kibibytes when negative
+        ConnectionOptions & CacheSize(int const size) noexcept
+        {
+            m_cacheSize = size;
+            return *this;
+        }
+
+        ConnectionOptions & TempStore(TempStoreMode const mode) noexcept
+        {
+            m_tempStore = mode;
+            return *this;
+        }
+
+        // see Connection::SetLookaside
+        ConnectionOptions & Lookaside(int const slotSize, int const slots) noexcept
+        {
+            m_lookaside = std::make_pair(slotSize, slots);
+            return *this;
+        }
+
+        // any other pragma, applied last in the order given
+        ConnectionOptions & Pragma(std::string name, std::string value)
+        {
+            m_pragmas.emplace_back(std::move(name), std::move(value));
+            return *this;
+        }
+
+        int GetFlags() const noexcept
+        {
+            return m_flags;
+        }
+
+        // nullptr for the default one
+        char const * GetVfs() const noexcept
+        {
+            return m_vfs.empty() ? nullptr : m_vfs.c_str();
+        }
+
+        // settings on a freshly opened connection
+        void Apply(sqlite3 * const connection) const
+        {
+            if(m_lookaside)
+            {
+                int const result = sqlite3_db_config(connection, SQLITE_DBCONFIG_LOOKASIDE, nullptr,
+                        m_lookaside->first, m_lookaside->second);
+                if(SQLITE_OK != result)
+                {
+                    throw Exception(result, "the lookaside is in use");
+                }
+            }
+
+            // before the journal mode, switching to WAL may have to wait for other connections
+            if(m_busyTimeout)
+            {
+                sqlite3_busy_timeout(connection, static_cast<int>(m_busyTimeout->count()));
+            }
+
+            if(m_journal)
+            {
+                std::string mode;
+                Run(connection, std::string("pragma journal_mode = ") + JournalName(*m_journal), &mode);
+
+                char const * const filename = sqlite3_db_filename(connection, "main");
+                if(mode != JournalName(*m_journal) && filename && *filename)
+                {
+                    throw Exception(SQLITE_CANTOPEN, std::string("journal mode ") + JournalName(*m_journal) +
+                            " is not available for " + filename + ", it stays " + mode);
+                }
+            }
+
+            if(m_synchronous)
+            {
+                Run(connection, "pragma synchronous = " + std::to_string(static_cast<int>(*m_synchronous)));
+            }
+            if(m_mmapSize)
+            {
+                Run(connection, "pragma mmap_size = " + std::to_string(*m_mmapSize));
+            }
+            if(m_cacheSize)
+            {
+                Run(connection, "pragma cache_size = " + std::to_string(*m_cacheSize));
+            }
+            if(m_tempStore)
+            {
+                Run(connection, "pragma temp_store = " + std::to_string(static_cast<int>(*m_tempStore)));
+            }
+            for(auto const & pragma : m_pragmas)
+            {
+                Run(connection, "pragma " + pragma.first + " = " + pragma.second);
+            }
+        }
+
+        // PRESETS
+        // one writer filling a database that can be rebuilt if the machine crashes
+        static ConnectionOptions BulkLoad()
+        {
+            return ConnectionOptions()
+                    .Journal(JournalMode::Memory)
+                    .Synchronous(SynchronousMode::Off)
+                    .CacheSize(-256 * 1024)
+                    .TempStore(TempStoreMode::Memory);
+        }
+
+        // many readers and the odd writer, reads come straight from the mapped file
+        static ConnectionOptions ReadMostly()
+        {
+            return ConnectionOptions()
+                    .Journal(JournalMode::Wal)
+                    .Synchronous(SynchronousMode::Normal)
+                    .MmapSize(256ll * 1024 * 1024)
+                    .CacheSize(-64 * 1024)
+                    .TempStore(TempStoreMode::Memory)
+                    .BusyTimeout(std::chrono::seconds(5));
+        }
+
+        // small transactions that must survive a power loss once committed
+        static ConnectionOptions DurableOltp()
+        {
+            return ConnectionOptions()
+                    .Journal(JournalMode::Wal)
+                    .Synchronous(SynchronousMode::Full)
+                    .CacheSize(-16 * 1024)
+                    .BusyTimeout(std::chrono::seconds(5));
+        }
+
+        // "bulk-load", "read-mostly" or "durable-oltp"
+        static ConnectionOptions Preset(std::string_view const name)
+        {
+            if(name == "bulk-load") return BulkLoad();
+            if(name == "read-mostly") return ReadMostly();
+            if(name == "durable-oltp") return DurableOltp();
+
+            throw Exception(SQLITE_MISUSE, "unknown connection preset " + std::string(name));
+        }
+};
+
+// sqlite3_set_authorizer callbacks: context, action code and up to four names
+using Authorizer = int (*)(void *, int, char const *, char const *, char const *, char const *);
+
+// defined after Statement
+class StatementCache;
+class CachedStatement;
+class ResultCache;
+
+// sqlite3_serialize and sqlite3_deserialize are built in since 3.36, optional before
+#if (SQLITE_VERSION_NUMBER >= 3036000 || defined(SQLITE_ENABLE_DESERIALIZE)) && !defined(SQLITE_OMIT_DESERIALIZE)
+#define TACOLITE_HAS_DESERIALIZE
+#endif
+
+#ifdef TACOLITE_HAS_DESERIALIZE
+// the bytes of a whole database file, in memory allocated by sqlite
+class SerializedDatabase
+{
+        struct SerializedHandleTraits : HandleTraits<unsigned char *>
+        {
+            static void Close(Type value) noexcept
+            {
+                sqlite3_free(value);
+            }
+        };
+
+        Handle<SerializedHandleTraits> m_data;
+        sqlite3_int64 m_size = 0;
+
+    public:
+        SerializedDatabase() noexcept = default;
+
+        SerializedDatabase(unsigned char * const data, sqlite3_int64 const size) noexcept :
+        m_data{data},
+        m_size{size}
+        {}
+
+        explicit operator bool() const noexcept
+        {
+            return static_cast<bool>(m_data);
+        }
+
+        std::span<std::byte const> Bytes() const noexcept
+        {
+            return {reinterpret_cast<std::byte const *>(m_data.Get()), static_cast<std::size_t>(m_size)};
+        }
+
+        sqlite3_int64 Size() const noexcept
+        {
+            return m_size;
+        }
+
+        // ownership goes to the caller, to be released with sqlite3_free
+        unsigned char * Detach() noexcept
+        {
+            m_size = 0;
+            return m_data.Detach();
+        }
 };
+#endif
 
 // Modeling connections
 class Connection
@@ -58,12 +544,29 @@ class Connection
         // alias for convenience
         using ConnectionHandle = Handle<ConnectionHandleTraits>;
 
+        // memory read by deserialized schemas without a copy, released after the handle is closed
+        std::unordered_map<std::string, std::shared_ptr<void const>> m_borrowed;
+
         ConnectionHandle m_handle;
 
+        // prepared statements keyed by sql text, created on first use
+        mutable std::unique_ptr<StatementCache> m_cache;
+        // rows of queries run through CachedQuery, created on first use
+        mutable std::unique_ptr<ResultCache> m_results;
+
+        StatementCache & Cache() const;
+        ResultCache & Results() const;
+
+        // finalizing every cached statement, defined bellow StatementCache
+        void CloseCache() noexcept;
+
         // function and a character
         template <typename F, typename C>
         void InternalOpen(F open, C const * const filename)
         {
+            // cached statements belong to the database being closed
+            CloseCache();
+
             Connection temp;
             // open the database file
             if(SQLITE_OK != open(filename, temp.m_handle.Set()))
@@ -73,17 +576,62 @@ class Connection
             }
             // In handle header
             Swap(m_handle, temp.m_handle);
+            // borrowed memory goes with the old handle
+            std::swap(m_borrowed, temp.m_borrowed);
         }
+
+#ifdef TACOLITE_HAS_DESERIALIZE
+        // WAL databases can not be opened in memory, their header says rollback journal instead
+        static void ClearWal(unsigned char * const data, sqlite3_int64 const size) noexcept
+        {
+            if(size >= 20 && data[18] == 2 && data[19] == 2)
+            {
+                data[18] = 1;
+                data[19] = 1;
+            }
+        }
+
+        void InternalDeserialize(char const * const schema, unsigned char * const data, sqlite3_int64 const size,
+                unsigned const flags)
+        {
+            // the rows change without the update hook
+            FlushResults();
+
+            // sqlite frees data when this fails and FREEONCLOSE is set, the error
+            // message of the connection is not always set
+            int const result = sqlite3_deserialize(GetAbi(), schema, data, size, size, flags);
+            if(SQLITE_OK != result)
+            {
+                throw Exception(result, std::string("can not deserialize into ") + schema + ": " + sqlite3_errstr(result));
+            }
+        }
+#endif
     public:
 
         Connection() noexcept = default;
 
+        // cached statements must be finalized before the handle is closed,
+        // these are defined bellow StatementCache
+        Connection(Connection && other) noexcept;
+        Connection & operator=(Connection && other) noexcept;
+        ~Connection() noexcept;
+
         template <typename C>
         explicit Connection(C const * const filename)
         {
             Open(filename);
         }
 
+        Connection(char const * const filename, int const flags)
+        {
+            Open(filename, flags);
+        }
+
+        Connection(char const * const filename, ConnectionOptions const & options)
+        {
+            Open(filename, options);
+        }
+
         static Connection Memory()
         {
             // to create in memory connections
@@ -126,6 +674,80 @@ class Connection
             InternalOpen(sqlite3_open16, filename);
         }
 
+        // SQLITE_OPEN_* flags such as SQLITE_OPEN_READONLY or SQLITE_OPEN_NOMUTEX
+        void Open(char const * const filename, int const flags)
+        {
+            InternalOpen([flags](char const * const name, sqlite3 ** const handle)
+            {
+                return sqlite3_open_v2(name, handle, flags, nullptr);
+            }, filename);
+        }
+
+        void Open(char const * const filename, ConnectionOptions const & options)
+        {
+            InternalOpen([&options](char const * const name, sqlite3 ** const handle)
+            {
+                int const result = sqlite3_open_v2(name, handle, options.GetFlags(), options.GetVfs());
+                // a failing setting throws while the handle still closes the connection
+                if(SQLITE_OK == result) options.Apply(*handle);
+                return result;
+            }, filename);
+        }
+
+#ifdef TACOLITE_HAS_DESERIALIZE
+        // SNAPSHOTS, the whole database as the bytes of its file
+        SerializedDatabase Serialize(char const * const schema = "main") const
+        {
+            sqlite3_int64 size = 0;
+            unsigned char * const data = sqlite3_serialize(GetAbi(), schema, &size, 0);
+            if(!data)
+            {
+                // an empty database serializes to nothing at all
+                if(size == 0 && sqlite3_errcode(GetAbi()) == SQLITE_OK) return SerializedDatabase();
+                throw Exception(SQLITE_NOMEM, "the database could not be serialized");
+            }
+            return SerializedDatabase(data, size);
+        }
+
+        // schema becomes an in memory database that owns the bytes, it stays writable and grows as needed
+        void DeserializeFrom(SerializedDatabase && database, char const * const schema = "main")
+        {
+            sqlite3_int64 const size = database.Size();
+            unsigned char * const data = database.Detach();
+            ClearWal(data, size);
+
+            InternalDeserialize(schema, data, size, SQLITE_DESERIALIZE_FREEONCLOSE | SQLITE_DESERIALIZE_RESIZEABLE);
+            m_borrowed.erase(schema);
+        }
+
+        // a copy of bytes, writable
+        void DeserializeFrom(std::span<std::byte const> const bytes, char const * const schema = "main")
+        {
+            auto const size = static_cast<sqlite3_int64>(bytes.size());
+            auto const data = static_cast<unsigned char *>(sqlite3_malloc64(bytes.size() ? bytes.size() : 1));
+            if(!data)
+            {
+                throw Exception(SQLITE_NOMEM, "no memory for a copy of the database");
+            }
+            std::memcpy(data, bytes.data(), bytes.size());
+
+            DeserializeFrom(SerializedDatabase(data, size), schema);
+        }
+
+        // bytes read in place, no copy: the database is read only and owner keeps the
+        // bytes alive until the connection closes or the schema is replaced;
+        // a WAL header has to be cleared by the caller (bytes 18 and 19 set to 1)
+        void DeserializeFrom(std::span<std::byte const> const bytes, std::shared_ptr<void const> owner,
+                char const * const schema = "main")
+        {
+            // sqlite never writes a read only database
+            InternalDeserialize(schema, reinterpret_cast<unsigned char *>(const_cast<std::byte *>(bytes.data())),
+                    static_cast<sqlite3_int64>(bytes.size()), SQLITE_DESERIALIZE_READONLY);
+            // a previous owner of this schema is not used anymore
+            m_borrowed[schema] = std::move(owner);
+        }
+#endif
+
         // to be able to get the las RowId inserted
         long long RowId() const noexcept
         {
@@ -138,9 +760,89 @@ class Connection
             // profiling the connection to increase the performance
             sqlite3_profile(GetAbi(), callback, context);
         }
-};
 
-// BACKUP CLASS:
+        // small allocations of this connection come from slots of its own, without locking,
+        // fails with SQLITE_BUSY while any slot is in use so better right after Open,
+        // builds with SQLITE_OMIT_LOOKASIDE accept it and do nothing
+        void SetLookaside(int const slotSize, int const slots) const
+        {
+            // idle cached statements may hold slots
+            FlushCache();
+
+            int const result = sqlite3_db_config(GetAbi(), SQLITE_DBCONFIG_LOOKASIDE, nullptr, slotSize, slots);
+            if(SQLITE_OK != result)
+            {
+                throw Exception(result, "the lookaside is in use");
+            }
+        }
+
+        // slots in use now and the highest count so far
+        std::pair<int, int> LookasideUsed() const noexcept
+        {
+            int current = 0;
+            int highest = 0;
+            sqlite3_db_status(GetAbi(), SQLITE_DBSTATUS_LOOKASIDE_USED, &current, &highest, 0);
+            return {current, highest};
+        }
+
+        // PREPARED STATEMENT CACHE
+        // borrow a prepared statement for this text, reset and bound to values,
+        // it goes back to the cache when the returned object is destroyed
+        template <typename ... Values>
+        CachedStatement Cached(char const * const text, Values && ... values) const;
+
+        // maximum number of idle statements kept, 0 disables caching
+        void SetCacheCapacity(std::size_t const capacity) const;
+
+        StatementCacheStats CacheStats() const noexcept;
+
+        // finalize every idle statement, borrowed ones are dropped when returned
+        void FlushCache() const noexcept;
+
+        // called for every action of every statement prepared, after the statement
+        // cache has seen it, and its verdict is the one sqlite gets; nullptr removes it.
+        // Calling sqlite3_set_authorizer directly replaces the one of the cache:
+        // schema changes then leave stale statements cached, and CachedQuery no
+        // longer knows the tables a query reads so any change makes it run again
+        void SetAuthorizer(Authorizer callback, void * context = nullptr) const;
+
+        // RESULT CACHE, defined bellow StatementCache
+        // every row of a query decoded into T once and shared until a table it read
+        // is changed, keyed by the text and the values bound; takes over the update
+        // and rollback hooks of the connection. Rows with std::string_view or span
+        // columns can not be cached, nor queries of virtual tables or of
+        // non deterministic functions such as random()
+        template <typename T, typename ... Values>
+        std::shared_ptr<std::vector<T> const> CachedQuery(char const * const text, Values && ... values) const;
+
+        void SetResultCacheOptions(ResultCacheOptions const & options) const;
+
+        ResultCacheStats ResultStats() const noexcept;
+
+        void FlushResults() const noexcept;
+
+        // USER DEFINED FUNCTIONS, defined bellow the column traits
+        // select name(a, b): arguments and result deduced from the callable,
+        // deterministic functions can be used in indexes and are factored out by the planner
+        template <typename F>
+        void CreateFunction(char const * const name, F function, int const flags = SQLITE_DETERMINISTIC) const;
+
+        // a State is constructed for every group, State::Step takes the arguments
+        // of each row and State::Final returns the result
+        template <typename State>
+        void CreateAggregate(char const * const name, int const flags = SQLITE_DETERMINISTIC) const;
+};
+
+// result of an incremental backup step
+enum class BackupState
+{
+        Copying,
+        // the source is in use, the step has to be tried again
+        Busy,
+        Done,
+};
+
+// BACKUP CLASS:
 /*
  * Useful when remote servers or want to persist data from a in memory db
  * Useful when want to backup a live database
@@ -201,363 +903,2047 @@ class Backup
             m_handle.Reset();
             m_destination->ThrowLastError();
         }
+
+        // like Step, but a source busy or locked by a writer is not an error,
+        // the next call just tries again
+        BackupState TryStep(int const pages)
+        {
+            int const result = sqlite3_backup_step(GetAbi(), pages);
+
+            if(result == SQLITE_OK) return BackupState::Copying;
+            if(result == SQLITE_DONE) return BackupState::Done;
+            if(result == SQLITE_BUSY || result == SQLITE_LOCKED) return BackupState::Busy;
+
+            m_handle.Reset();
+            m_destination->ThrowLastError();
+            return BackupState::Done;
+        }
+
+        // pages still to be copied, known after the first step
+        int Remaining() const noexcept
+        {
+            return sqlite3_backup_remaining(GetAbi());
+        }
+
+        // pages in the source, known after the first step
+        int PageCount() const noexcept
+        {
+            return sqlite3_backup_pagecount(GetAbi());
+        }
 };
 
-// ROW READER FOR STATEMENTS
-template <typename T>
-struct Reader
+// INCREMENTAL BACKUP
+// copying a few pages at a time, the source is only locked while a slice is copied
+struct BackupOptions
 {
-    // to be able to read rows by columns in the controller or main
-    int GetInt(int const column = 0) const noexcept
+    int PagesPerStep = 256;
+    // time given to writers between slices
+    std::chrono::milliseconds Pause{1};
+    // database of the source to copy: main, temp or the name of an attached one
+    char const * Source = "main";
+};
+
+struct BackupProgress
+{
+    int Remaining = 0;
+    int PageCount = 0;
+
+    double Fraction() const noexcept
     {
-        // doing a static cast because GetAbi is a const method
-        return sqlite3_column_int(static_cast<T const *>(this)->GetAbi(), column);
+        return PageCount > 0 ? 1.0 - static_cast<double>(Remaining) / PageCount : 0.0;
     }
+};
 
-    // to be able to read rows by columns in the controller or main
-    double GetFloat(int const column = 0) const noexcept
+// progress is called after every slice and returns false to cancel,
+// the result is true when the backup is complete; a cancelled or failed backup
+// leaves the destination as it was before, sqlite3_backup_finish rolls back the
+// write transaction the slices were copied in
+template <typename F>
+bool IncrementalBackup(Connection const & destination, Connection const & source,
+        BackupOptions const & options, F progress)
+{
+    Backup backup(destination, source, "main", options.Source);
+
+    for(;;)
     {
-        // doing a static cast because GetAbi is a const method
-        return sqlite3_column_double(static_cast<T const *>(this)->GetAbi(), column);
+        BackupState const state = backup.TryStep(options.PagesPerStep > 0 ? options.PagesPerStep : -1);
+
+        if(!progress(BackupProgress{backup.Remaining(), backup.PageCount()}))
+        {
+            // the backup handle rolls the destination back when it is closed
+            return false;
+        }
+        if(state == BackupState::Done) return true;
+
+        if(state == BackupState::Busy)
+        {
+            std::this_thread::sleep_for(std::max(options.Pause, std::chrono::milliseconds(1)));
+        }
+        else if(options.Pause.count() > 0)
+        {
+            std::this_thread::sleep_for(options.Pause);
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
     }
+}
 
-    char const * GetString(int const column = 0) const noexcept
+inline bool IncrementalBackup(Connection const & destination, Connection const & source,
+        BackupOptions const & options = BackupOptions())
+{
+    return IncrementalBackup(destination, source, options, [](BackupProgress const &) { return true; });
+}
+
+// COLUMN DECODING RESOLVED AT COMPILE TIME
+// affinity of a declared column type, following the sqlite rules
+enum class Affinity
+{
+        Integer,
+        Text,
+        Blob,
+        Real,
+        Numeric,
+};
+
+inline Affinity DeclaredAffinity(char const * const declared) noexcept
+{
+    std::string upper(declared);
+    for(char & c : upper)
     {
-        return reinterpret_cast<char const *>(sqlite3_column_text(
-                static_cast<T const *>(this)->GetAbi(), column
-                ));
+        if(c >= 'a' && c <= 'z') c = static_cast<char>(c - 'a' + 'A');
     }
 
-    // string overloaded for no regular string
-    wchar_t const * GetWideString(int const column = 0) const noexcept
+    auto const has = [&upper](char const * const part)
     {
-        return static_cast<wchar_t const *>(sqlite3_column_text16(
-                static_cast<T const *>(this)->GetAbi(), column
-                ));
+        return upper.find(part) != std::string::npos;
+    };
+
+    if(has("INT")) return Affinity::Integer;
+    if(has("CHAR") || has("CLOB") || has("TEXT")) return Affinity::Text;
+    if(upper.empty() || has("BLOB")) return Affinity::Blob;
+    if(has("REAL") || has("FLOA") || has("DOUB")) return Affinity::Real;
+    return Affinity::Numeric;
+}
+
+// numbers by default, specialized bellow for text
+template <typename T>
+struct ColumnTraits
+{
+    static_assert(std::is_arithmetic_v<T>, "no ColumnTraits specialization for this type");
+
+    static T Get(sqlite3_stmt * const statement, int const column) noexcept
+    {
+        if constexpr (std::is_integral_v<T>)
+        {
+            return static_cast<T>(sqlite3_column_int64(statement, column));
+        }
+        else
+        {
+            return static_cast<T>(sqlite3_column_double(statement, column));
+        }
     }
 
-    int GetStringLength(int const column = 0) const noexcept
+    // text columns do not hold numbers, columns declared without type hold anything
+    static bool Accepts(Affinity const affinity) noexcept
     {
-        return sqlite3_column_bytes(static_cast<T const *>(this)->GetAbi(), column);
+        return affinity != Affinity::Text;
     }
+};
 
-    int GetWideStringLength(int const column = 0) const noexcept
+template <>
+struct ColumnTraits<std::string>
+{
+    static std::string Get(sqlite3_stmt * const statement, int const column)
     {
-        return sqlite3_column_bytes16(static_cast<T const *>(this)->GetAbi(), column) / sizeof(wchar_t);
+        // text first, then its length
+        auto const text = reinterpret_cast<char const *>(sqlite3_column_text(statement, column));
+        return text ? std::string(text, sqlite3_column_bytes(statement, column)) : std::string();
     }
 
-    Type GetType(int const column = 0) const noexcept
+    static bool Accepts(Affinity) noexcept
     {
-        // hanlding sqlite3 dynamic type selection
-        return static_cast<Type>(sqlite3_column_type(static_cast<T const *>(this)->GetAbi(), column));
+        return true;
     }
 };
 
-// ROW READER BASED ON A MODERN C++ FOR LOOP
-class Row : public Reader<Row>
+// valid until the next step of the statement
+template <>
+struct ColumnTraits<std::string_view>
 {
-        sqlite3_stmt * m_statement = nullptr;
-    public:
-        sqlite3_stmt * GetAbi() const noexcept
-        {
-            return m_statement;
-        }
+    static std::string_view Get(sqlite3_stmt * const statement, int const column) noexcept
+    {
+        auto const text = reinterpret_cast<char const *>(sqlite3_column_text(statement, column));
+        return text ? std::string_view(text, sqlite3_column_bytes(statement, column)) : std::string_view();
+    }
 
-        Row(sqlite3_stmt * const statement) noexcept :
-        m_statement{statement}
-        {}
-        // row iterator class is at the bottom if this header
+    static bool Accepts(Affinity) noexcept
+    {
+        return true;
+    }
 };
 
-// SQLITE STATEMENTS HANDLERS
+template <>
+struct ColumnTraits<std::wstring>
+{
+    static std::wstring Get(sqlite3_stmt * const statement, int const column)
+    {
+        auto const text = static_cast<wchar_t const *>(sqlite3_column_text16(statement, column));
+        return text ? std::wstring(text, sqlite3_column_bytes16(statement, column) / sizeof(wchar_t)) : std::wstring();
+    }
 
-class Statement : public Reader<Statement>
+    static bool Accepts(Affinity) noexcept
+    {
+        return true;
+    }
+};
+
+// blobs, valid until the next step of the statement
+template <>
+struct ColumnTraits<std::span<std::byte const>>
 {
-    private:
-        struct StatementHandleTraits : HandleTraits<sqlite3_stmt *>
-        {
-            static void Close(Type value) noexcept
-            {
-                VERIFY_(SQLITE_OK, sqlite3_finalize(value));
-            }
-        };
+    static std::span<std::byte const> Get(sqlite3_stmt * const statement, int const column) noexcept
+    {
+        auto const data = static_cast<std::byte const *>(sqlite3_column_blob(statement, column));
+        return data ? std::span<std::byte const>(data, sqlite3_column_bytes(statement, column)) : std::span<std::byte const>();
+    }
 
-        // statement alias
-        using StatementHandle = Handle<StatementHandleTraits>;
+    static bool Accepts(Affinity) noexcept
+    {
+        return true;
+    }
+};
 
-        StatementHandle m_handle;
+// null columns become std::nullopt
+template <typename T>
+struct ColumnTraits<std::optional<T>>
+{
+    static std::optional<T> Get(sqlite3_stmt * const statement, int const column)
+    {
+        if(sqlite3_column_type(statement, column) == SQLITE_NULL) return std::nullopt;
+        return ColumnTraits<T>::Get(statement, column);
+    }
 
-        // variatic template ...
-        template <typename F, typename C, typename ... Values>
-        void InternalPrepare(Connection const & connection, F prepare, C const * const text,
-                Values && ... values)
-        {
-            // in case a bad connection
-            assert(connection);
-            // STATEMENT TEXT OR QUERY PROCESSING
-            if(SQLITE_OK != prepare(connection.GetAbi(), text, -1, m_handle.Set(), nullptr))
-            {
-                connection.ThrowLastError();
-            }
-            // to bind in same line Prepare is calling
-            BindAll(std::forward<Values>(values)...);
-        }
+    static bool Accepts(Affinity const affinity) noexcept
+    {
+        return ColumnTraits<T>::Accepts(affinity);
+    }
+};
 
-        void InternalBind(int) const noexcept
-        {
-            // terminanting function for binding all
-            // last element of the expansion pack bellow, ends here
-        }
-        // called for automatic binding
-        template <typename First, typename ... Rest>
-        void InternalBind(int const index, First && first, Rest && ... rest) const
-        {
-            // fouding correct binding for each value in the parameter pack
-            Bind(index, std::forward<First>(first));
-            // the pack minus the element binded yet
-            InternalBind(index+1, std::forward<Rest>(rest)...);
-        }
+// how a whole row becomes a T: one column by default, specialize it for structs
+//     template <> struct RowTraits<User> { using Columns = std::tuple<long long, std::string>; };
+// the struct is brace initialized with the columns in order
+template <typename T>
+struct RowTraits
+{
+    using Columns = std::tuple<T>;
+};
 
+template <typename ... Values>
+struct RowTraits<std::tuple<Values ...>>
+{
+    using Columns = std::tuple<Values ...>;
+};
 
-    public:
-        Statement() noexcept = default;
+template <typename Columns, std::size_t ... Indexes>
+void InternalCheckColumns(sqlite3_stmt * const statement, std::index_sequence<Indexes ...>)
+{
+    if(sqlite3_column_count(statement) != static_cast<int>(sizeof...(Indexes)))
+    {
+        throw Exception(SQLITE_MISMATCH, "query returns " + std::to_string(sqlite3_column_count(statement)) +
+                " columns, the row type expects " + std::to_string(sizeof...(Indexes)));
+    }
 
-        // prepare statement in one step in constructor
-        template <typename C, typename ... Values>
-        Statement(Connection const & connection, C const * const text,
-                Values && ... values)
-        {
-            Prepare(connection, text, std::forward<Values>(values) ...);
-        }
+    // expressions have no declared type, they can not be checked
+    bool const accepted[] = {true, [statement]
+    {
+        char const * const declared = sqlite3_column_decltype(statement, Indexes);
+        return !declared || ColumnTraits<std::tuple_element_t<Indexes, Columns>>::Accepts(DeclaredAffinity(declared));
+    }()...};
 
-        explicit operator bool() const noexcept
+    for(std::size_t column = 0; column != sizeof...(Indexes); ++column)
+    {
+        if(!accepted[column + 1])
         {
-            return static_cast<bool>(m_handle);
+            throw Exception(SQLITE_MISMATCH, "column " + std::to_string(column) + " is declared as " +
+                    sqlite3_column_decltype(statement, static_cast<int>(column)) + ", not readable as the row type");
         }
+    }
+}
 
-        // abi
-        sqlite3_stmt * GetAbi() const noexcept
-        {
-            return m_handle.Get();
-        }
+// column count and declared types checked once, after prepare
+template <typename T>
+void CheckColumns(sqlite3_stmt * const statement)
+{
+    using Columns = typename RowTraits<T>::Columns;
+    InternalCheckColumns<Columns>(statement, std::make_index_sequence<std::tuple_size_v<Columns>>());
+}
 
-        void ThrowLastError() const
-        {
-            throw Exception (sqlite3_db_handle(GetAbi()));
-        }
+// USER DEFINED FUNCTIONS
+// arguments of a function decoded like columns, text and blobs valid until it returns
+template <typename T>
+struct ValueTraits
+{
+    static_assert(std::is_arithmetic_v<T>, "no ValueTraits specialization for this type");
 
-        // prepare overloading for different encodings
-        // to accepts any source arguments
-        template <typename ... Values>
-        void Prepare(Connection const & connection, char const * const text,
-                Values && ... values)
+    static T Get(sqlite3_value * const value) noexcept
+    {
+        if constexpr (std::is_integral_v<T>)
         {
-            // calling query proccessor
-            // prepare_V2 much more stable with error recording
-            // std::forward<Values>(values)... is for unpacking the values in template ...
-            InternalPrepare(connection, sqlite3_prepare_v2,
-                    text, std::forward<Values>(values)...);
+            return static_cast<T>(sqlite3_value_int64(value));
         }
-
-        // to accepts any source arguments
-        template <typename ... Values>
-        void Prepare(Connection const & connection, wchar_t const * const text,
-                Values && ... values)
+        else
         {
-            // calling query proccessor
-            InternalPrepare(connection, sqlite3_prepare16_v2,
-                    text, std::forward<Values>(values)...);
+            return static_cast<T>(sqlite3_value_double(value));
         }
+    }
+};
 
-        bool Step() const
-        {
-            // statement executions
-            int const result = sqlite3_step(GetAbi());
-            // it is still executing
-            if(result == SQLITE_ROW) return true;
-            // it says it has been executed successfully
-            if(result == SQLITE_DONE) return false;
-
-            // in case no response is received
-            ThrowLastError();
-        }
+template <>
+struct ValueTraits<std::string>
+{
+    static std::string Get(sqlite3_value * const value)
+    {
+        auto const text = reinterpret_cast<char const *>(sqlite3_value_text(value));
+        return text ? std::string(text, sqlite3_value_bytes(value)) : std::string();
+    }
+};
+
+template <>
+struct ValueTraits<std::string_view>
+{
+    static std::string_view Get(sqlite3_value * const value) noexcept
+    {
+        auto const text = reinterpret_cast<char const *>(sqlite3_value_text(value));
+        return text ? std::string_view(text, sqlite3_value_bytes(value)) : std::string_view();
+    }
+};
+
+template <>
+struct ValueTraits<std::span<std::byte const>>
+{
+    static std::span<std::byte const> Get(sqlite3_value * const value) noexcept
+    {
+        auto const data = static_cast<std::byte const *>(sqlite3_value_blob(value));
+        return data ? std::span<std::byte const>(data, sqlite3_value_bytes(value)) : std::span<std::byte const>();
+    }
+};
+
+// null arguments become std::nullopt
+template <typename T>
+struct ValueTraits<std::optional<T>>
+{
+    static std::optional<T> Get(sqlite3_value * const value)
+    {
+        if(sqlite3_value_type(value) == SQLITE_NULL) return std::nullopt;
+        return ValueTraits<T>::Get(value);
+    }
+};
+
+// the value as it is, for functions that look at its type themselves
+template <>
+struct ValueTraits<sqlite3_value *>
+{
+    static sqlite3_value * Get(sqlite3_value * const value) noexcept
+    {
+        return value;
+    }
+};
+
+// results of a function, sqlite copies text and blobs before the function returns
+template <typename T>
+void SetResult(sqlite3_context * const context, T const value) noexcept
+{
+    static_assert(std::is_arithmetic_v<T>, "no SetResult overload for this type");
+
+    if constexpr (std::is_integral_v<T>)
+    {
+        sqlite3_result_int64(context, static_cast<sqlite3_int64>(value));
+    }
+    else
+    {
+        sqlite3_result_double(context, static_cast<double>(value));
+    }
+}
+
+inline void SetResult(sqlite3_context * const context, std::string_view const value) noexcept
+{
+    sqlite3_result_text64(context, value.data() ? value.data() : "", value.size(), SQLITE_TRANSIENT, SQLITE_UTF8);
+}
+
+inline void SetResult(sqlite3_context * const context, std::string const & value) noexcept
+{
+    SetResult(context, std::string_view(value));
+}
+
+inline void SetResult(sqlite3_context * const context, char const * const value) noexcept
+{
+    if(value) SetResult(context, std::string_view(value));
+    else sqlite3_result_null(context);
+}
+
+inline void SetResult(sqlite3_context * const context, std::span<std::byte const> const value) noexcept
+{
+    if(value.data()) sqlite3_result_blob64(context, value.data(), value.size(), SQLITE_TRANSIENT);
+    else sqlite3_result_zeroblob(context, 0);
+}
+
+inline void SetResult(sqlite3_context * const context, std::nullopt_t) noexcept
+{
+    sqlite3_result_null(context);
+}
+
+template <typename T>
+void SetResult(sqlite3_context * const context, std::optional<T> const & value) noexcept
+{
+    if(value) SetResult(context, *value);
+    else sqlite3_result_null(context);
+}
+
+// the signature of lambdas, function pointers and member functions
+template <typename F>
+struct FunctionTraits : FunctionTraits<decltype(&F::operator())>
+{
+};
+
+template <typename R, typename ... Arguments>
+struct FunctionTraits<R (*)(Arguments ...)>
+{
+    using Result = R;
+    using ArgumentTuple = std::tuple<std::decay_t<Arguments> ...>;
+};
+
+template <typename R, typename ... Arguments>
+struct FunctionTraits<R (*)(Arguments ...) noexcept> : FunctionTraits<R (*)(Arguments ...)>
+{
+};
+
+template <typename R, typename C, typename ... Arguments>
+struct FunctionTraits<R (C::*)(Arguments ...)> : FunctionTraits<R (*)(Arguments ...)>
+{
+};
+
+template <typename R, typename C, typename ... Arguments>
+struct FunctionTraits<R (C::*)(Arguments ...) const> : FunctionTraits<R (*)(Arguments ...)>
+{
+};
+
+template <typename R, typename C, typename ... Arguments>
+struct FunctionTraits<R (C::*)(Arguments ...) noexcept> : FunctionTraits<R (*)(Arguments ...)>
+{
+};
+
+template <typename R, typename C, typename ... Arguments>
+struct FunctionTraits<R (C::*)(Arguments ...) const noexcept> : FunctionTraits<R (*)(Arguments ...)>
+{
+};
+
+// calling a C++ function from the C callbacks of sqlite, exceptions become sql errors
+class FunctionDispatch
+{
+        template <typename Arguments, typename F, std::size_t ... Indexes>
+        static decltype(auto) Call(F && function, sqlite3_value ** const values, std::index_sequence<Indexes ...>)
+        {
+            return std::forward<F>(function)(ValueTraits<std::tuple_element_t<Indexes, Arguments>>::Get(values[Indexes])...);
+        }
+
+    public:
+        template <typename Arguments, typename F>
+        static void Invoke(sqlite3_context * const context, F && function, sqlite3_value ** const values) noexcept
+        {
+            try
+            {
+                using Indexes = std::make_index_sequence<std::tuple_size_v<Arguments>>;
+
+                if constexpr (std::is_void_v<decltype(Call<Arguments>(std::forward<F>(function), values, Indexes()))>)
+                {
+                    Call<Arguments>(std::forward<F>(function), values, Indexes());
+                }
+                else
+                {
+                    SetResult(context, Call<Arguments>(std::forward<F>(function), values, Indexes()));
+                }
+            }
+            catch(...)
+            {
+                Fail(context);
+            }
+        }
+
+        static void Fail(sqlite3_context * const context) noexcept
+        {
+            try
+            {
+                throw;
+            }
+            catch(Exception const & e)
+            {
+                sqlite3_result_error(context, e.Message.c_str(), -1);
+                sqlite3_result_error_code(context, e.Result);
+            }
+            catch(std::bad_alloc const &)
+            {
+                sqlite3_result_error_nomem(context);
+            }
+            catch(std::exception const & e)
+            {
+                sqlite3_result_error(context, e.what(), -1);
+            }
+            catch(...)
+            {
+                sqlite3_result_error(context, "unknown exception in a user defined function", -1);
+            }
+        }
+};
+
+template <typename F>
+void Connection::CreateFunction(char const * const name, F function, int const flags) const
+{
+    using Arguments = typename FunctionTraits<F>::ArgumentTuple;
+
+    auto const call = [](sqlite3_context * const context, int, sqlite3_value ** const values) noexcept
+    {
+        FunctionDispatch::Invoke<Arguments>(context, *static_cast<F *>(sqlite3_user_data(context)), values);
+    };
+
+    auto const destroy = [](void * const function) noexcept
+    {
+        delete static_cast<F *>(function);
+    };
+
+    // sqlite owns the copy from now on and destroys it, even when this call fails
+    if(SQLITE_OK != sqlite3_create_function_v2(GetAbi(), name, static_cast<int>(std::tuple_size_v<Arguments>),
+            SQLITE_UTF8 | flags, new F(std::move(function)), call, nullptr, nullptr, destroy))
+    {
+        ThrowLastError();
+    }
+}
+
+template <typename State>
+void Connection::CreateAggregate(char const * const name, int const flags) const
+{
+    using Arguments = typename FunctionTraits<decltype(&State::Step)>::ArgumentTuple;
+
+    // the state lives in the aggregate context of sqlite, zeroed on allocation
+    struct Slot
+    {
+        alignas(State) unsigned char Storage[sizeof(State)];
+        bool Constructed;
+    };
+    static_assert(alignof(Slot) <= 8, "sqlite only aligns aggregate contexts to 8 bytes");
+
+    auto const step = [](sqlite3_context * const context, int, sqlite3_value ** const values) noexcept
+    {
+        auto const slot = static_cast<Slot *>(sqlite3_aggregate_context(context, sizeof(Slot)));
+        if(!slot)
+        {
+            sqlite3_result_error_nomem(context);
+            return;
+        }
+
+        try
+        {
+            if(!slot->Constructed)
+            {
+                new (slot->Storage) State();
+                slot->Constructed = true;
+            }
+        }
+        catch(...)
+        {
+            FunctionDispatch::Fail(context);
+            return;
+        }
+
+        State & state = *std::launder(reinterpret_cast<State *>(slot->Storage));
+        FunctionDispatch::Invoke<Arguments>(context, [&state](auto && ... arguments) -> decltype(auto)
+        {
+            return state.Step(std::forward<decltype(arguments)>(arguments)...);
+        }, values);
+    };
+
+    // called once per group, also when the statement is reset before finishing it
+    auto const final = [](sqlite3_context * const context) noexcept
+    {
+        auto const slot = static_cast<Slot *>(sqlite3_aggregate_context(context, 0));
+
+        if(slot && slot->Constructed)
+        {
+            State & state = *std::launder(reinterpret_cast<State *>(slot->Storage));
+            FunctionDispatch::Invoke<std::tuple<>>(context, [&state]() -> decltype(auto) { return state.Final(); }, nullptr);
+            state.~State();
+            slot->Constructed = false;
+        }
+        else
+        {
+            // no rows in the group
+            FunctionDispatch::Invoke<std::tuple<>>(context, []() { return State().Final(); }, nullptr);
+        }
+    };
+
+    if(SQLITE_OK != sqlite3_create_function_v2(GetAbi(), name, static_cast<int>(std::tuple_size_v<Arguments>),
+            SQLITE_UTF8 | flags, nullptr, nullptr, step, final, nullptr))
+    {
+        ThrowLastError();
+    }
+}
+
+// ROW READER FOR STATEMENTS
+template <typename T>
+struct Reader
+{
+    // to be able to read rows by columns in the controller or main
+    int GetInt(int const column = 0) const noexcept
+    {
+        // doing a static cast because GetAbi is a const method
+        return sqlite3_column_int(static_cast<T const *>(this)->GetAbi(), column);
+    }
+
+    long long GetInt64(int const column = 0) const noexcept
+    {
+        return sqlite3_column_int64(static_cast<T const *>(this)->GetAbi(), column);
+    }
+
+    // to be able to read rows by columns in the controller or main
+    double GetFloat(int const column = 0) const noexcept
+    {
+        // doing a static cast because GetAbi is a const method
+        return sqlite3_column_double(static_cast<T const *>(this)->GetAbi(), column);
+    }
+
+    char const * GetString(int const column = 0) const noexcept
+    {
+        return reinterpret_cast<char const *>(sqlite3_column_text(
+                static_cast<T const *>(this)->GetAbi(), column
+                ));
+    }
+
+    // string overloaded for no regular string
+    wchar_t const * GetWideString(int const column = 0) const noexcept
+    {
+        return static_cast<wchar_t const *>(sqlite3_column_text16(
+                static_cast<T const *>(this)->GetAbi(), column
+                ));
+    }
+
+    // no copy, valid until the next step
+    std::string_view GetStringView(int const column = 0) const noexcept
+    {
+        return ColumnTraits<std::string_view>::Get(static_cast<T const *>(this)->GetAbi(), column);
+    }
+
+    // no copy, valid until the next step
+    std::span<std::byte const> GetBlob(int const column = 0) const noexcept
+    {
+        return ColumnTraits<std::span<std::byte const>>::Get(static_cast<T const *>(this)->GetAbi(), column);
+    }
+
+    int GetStringLength(int const column = 0) const noexcept
+    {
+        return sqlite3_column_bytes(static_cast<T const *>(this)->GetAbi(), column);
+    }
+
+    int GetWideStringLength(int const column = 0) const noexcept
+    {
+        return sqlite3_column_bytes16(static_cast<T const *>(this)->GetAbi(), column) / sizeof(wchar_t);
+    }
+
+    Type GetType(int const column = 0) const noexcept
+    {
+        // hanlding sqlite3 dynamic type selection
+        return static_cast<Type>(sqlite3_column_type(static_cast<T const *>(this)->GetAbi(), column));
+    }
+
+    // TYPED READING, the column type is chosen at compile time
+    // row.Get<std::string>(1)
+    template <typename Value>
+    Value Get(int const column = 0) const
+    {
+        return ColumnTraits<Value>::Get(static_cast<T const *>(this)->GetAbi(), column);
+    }
+
+    // consecutive columns into a tuple: row.As<long long, std::string_view, double>()
+    template <typename ... Values>
+    std::tuple<Values ...> As(int const first = 0) const
+    {
+        return InternalAs<Values ...>(first, std::index_sequence_for<Values ...>());
+    }
+
+    // the whole row as described by RowTraits<Value>
+    template <typename Value>
+    Value Read() const
+    {
+        using Columns = typename RowTraits<Value>::Columns;
+
+        return std::apply([](auto && ... values)
+        {
+            return Value{std::forward<decltype(values)>(values)...};
+        }, InternalAs(0, static_cast<Columns *>(nullptr)));
+    }
+
+private:
+    template <typename ... Values, std::size_t ... Indexes>
+    std::tuple<Values ...> InternalAs(int const first, std::index_sequence<Indexes ...>) const
+    {
+        sqlite3_stmt * const statement = static_cast<T const *>(this)->GetAbi();
+        // braces keep the columns read in order
+        return std::tuple<Values ...>{ColumnTraits<Values>::Get(statement, first + static_cast<int>(Indexes))...};
+    }
+
+    // unpacking the tuple of RowTraits
+    template <typename ... Values>
+    std::tuple<Values ...> InternalAs(int const first, std::tuple<Values ...> *) const
+    {
+        return As<Values ...>(first);
+    }
+};
+
+// ROW READER BASED ON A MODERN C++ FOR LOOP
+class Row : public Reader<Row>
+{
+        sqlite3_stmt * m_statement = nullptr;
+    public:
+        sqlite3_stmt * GetAbi() const noexcept
+        {
+            return m_statement;
+        }
+
+        Row(sqlite3_stmt * const statement) noexcept :
+        m_statement{statement}
+        {}
+        // row iterator class is at the bottom if this header
+};
+
+// SQLITE STATEMENTS HANDLERS
+
+class Statement : public Reader<Statement>
+{
+    protected:
+        // the cache keeps idle statements in the same handles
+        friend class StatementCache;
+
+        struct StatementHandleTraits : HandleTraits<sqlite3_stmt *>
+        {
+            static void Close(Type value) noexcept
+            {
+                VERIFY_(SQLITE_OK, sqlite3_finalize(value));
+            }
+        };
+
+        // statement alias
+        using StatementHandle = Handle<StatementHandleTraits>;
+
+        StatementHandle m_handle;
+
+    private:
+        // variatic template ...
+        template <typename F, typename C, typename ... Values>
+        void InternalPrepare(Connection const & connection, F prepare, C const * const text,
+                Values && ... values)
+        {
+            // in case a bad connection
+            assert(connection);
+            // STATEMENT TEXT OR QUERY PROCESSING
+            if(SQLITE_OK != prepare(connection.GetAbi(), text, -1, m_handle.Set(), nullptr))
+            {
+                connection.ThrowLastError();
+            }
+            // to bind in same line Prepare is calling
+            BindAll(std::forward<Values>(values)...);
+        }
+
+        void InternalBind(int) const noexcept
+        {
+            // terminanting function for binding all
+            // last element of the expansion pack bellow, ends here
+        }
+        // called for automatic binding
+        template <typename First, typename ... Rest>
+        void InternalBind(int const index, First && first, Rest && ... rest) const
+        {
+            // fouding correct binding for each value in the parameter pack
+            Bind(index, std::forward<First>(first));
+            // the pack minus the element binded yet
+            InternalBind(index+1, std::forward<Rest>(rest)...);
+        }
+
+
+    public:
+        Statement() noexcept = default;
+
+        Statement(Statement &&) noexcept = default;
+        Statement & operator=(Statement &&) noexcept = default;
+
+        // moving the handle out of a CachedStatement would leave its cache entry borrowed for good
+        Statement(CachedStatement &&) = delete;
+        Statement & operator=(CachedStatement &&) = delete;
+
+        // prepare statement in one step in constructor
+        template <typename C, typename ... Values>
+        Statement(Connection const & connection, C const * const text,
+                Values && ... values)
+        {
+            Prepare(connection, text, std::forward<Values>(values) ...);
+        }
+
+        explicit operator bool() const noexcept
+        {
+            return static_cast<bool>(m_handle);
+        }
+
+        // abi
+        sqlite3_stmt * GetAbi() const noexcept
+        {
+            return m_handle.Get();
+        }
+
+        void ThrowLastError() const
+        {
+            throw Exception (sqlite3_db_handle(GetAbi()));
+        }
+
+        // prepare overloading for different encodings
+        // to accepts any source arguments
+        template <typename ... Values>
+        void Prepare(Connection const & connection, char const * const text,
+                Values && ... values)
+        {
+            // calling query proccessor
+            // prepare_V2 much more stable with error recording
+            // std::forward<Values>(values)... is for unpacking the values in template ...
+            InternalPrepare(connection, sqlite3_prepare_v2,
+                    text, std::forward<Values>(values)...);
+        }
+
+        // to accepts any source arguments
+        template <typename ... Values>
+        void Prepare(Connection const & connection, wchar_t const * const text,
+                Values && ... values)
+        {
+            // calling query proccessor
+            InternalPrepare(connection, sqlite3_prepare16_v2,
+                    text, std::forward<Values>(values)...);
+        }
+
+        bool Step() const
+        {
+            // statement executions
+            int const result = sqlite3_step(GetAbi());
+            // it is still executing
+            if(result == SQLITE_ROW) return true;
+            // it says it has been executed successfully
+            if(result == SQLITE_DONE) return false;
+
+            // in case no response is received
+            ThrowLastError();
+        }
 
         void Execute() const {
             VERIFY(!Step());
         }
 
-        // BINDING STATEMENT ARGUMENTS
-        //integers
-        void Bind(int const index, int const value) const
+        // BINDING STATEMENT ARGUMENTS
+        //integers of any width, such as rowids or std::int64_t
+        template <std::integral I>
+        void Bind(int const index, I const value) const
+        {
+            // sqlite has no unsigned integers, the ones above INT64_MAX would bind as negative
+            if constexpr (std::is_unsigned_v<I> && sizeof(I) >= sizeof(sqlite3_int64))
+            {
+                if(value > static_cast<I>(std::numeric_limits<sqlite3_int64>::max()))
+                {
+                    throw Exception(SQLITE_RANGE, "unsigned value does not fit a 64 bit sqlite integer");
+                }
+            }
+
+            // zero is not valid in sql index
+            // binding inside logic
+            if(SQLITE_OK != sqlite3_bind_int64(GetAbi(), index, static_cast<sqlite3_int64>(value)))
+            {
+                ThrowLastError();
+            }
+        }
+
+        // double binding
+        void Bind(int const index, double const value) const
+        {
+            // zero is not valid in sql index
+            // binding inside logic
+            if(SQLITE_OK != sqlite3_bind_double(GetAbi(), index, value))
+            {
+                ThrowLastError();
+            }
+        }
+
+        void Bind(int const index, float const value) const
+        {
+            Bind(index, static_cast<double>(value));
+        }
+
+        // characters
+        //-1 sqlite binds all character as default
+        void Bind(int const index, char const * const value, int const size = -1) const
+        {
+            if(SQLITE_OK != sqlite3_bind_text(GetAbi(), index, value, size, SQLITE_STATIC))
+            {
+                // in case binding is not completed
+                ThrowLastError();
+            }
+        }
+
+        // wchat_t wide characters
+        void Bind(int const index, wchar_t const * const value, int const size = -1) const
+        {
+            // size is in bytes
+            // SQLITE_STATIC?
+            if(SQLITE_OK != sqlite3_bind_text16(GetAbi(), index, value, size, SQLITE_STATIC))
+            {
+                ThrowLastError();
+            }
+        }
+
+        void Bind(int const index, std::string const & value) const
+        {
+            Bind(index, value.c_str(), value.size());
+        }
+
+        void Bind(int const index, std::wstring const & value) const
+        {
+            Bind(index, value.c_str(), value.size() * sizeof(wchar_t));
+        }
+
+        // bindings for avoiding SQLITE_TRANSIENT in Bind chars
+        // Overloading to let sqlite doing a private copy
+        void Bind(int const index, std::string && value) const
+        {
+            if(SQLITE_OK != sqlite3_bind_text(GetAbi(),
+                    index, value.c_str(),value.size(), SQLITE_TRANSIENT))
+            {
+                ThrowLastError();
+            }
+        }
+
+        // for std::wstring binding
+        void Bind(int const index, std::wstring && value) const
+        {
+            if(SQLITE_OK != sqlite3_bind_text16(GetAbi(),
+                    index, value.c_str(), value.size() * sizeof(wchar_t), SQLITE_TRANSIENT))
+            {
+                ThrowLastError();
+            }
+        }
+
+        // text without a terminating zero, Static avoids the copy when the
+        // caller keeps the characters alive until the statement is stepped
+        void Bind(int const index, std::string_view const value,
+                Lifetime const lifetime = Lifetime::Static) const
+        {
+            // a null pointer would bind null instead of empty text
+            if(SQLITE_OK != sqlite3_bind_text64(GetAbi(), index, value.data() ? value.data() : "",
+                    value.size(), Destructor(lifetime), SQLITE_UTF8))
+            {
+                ThrowLastError();
+            }
+        }
+
+        // blobs
+        void Bind(int const index, std::span<std::byte const> const value,
+                Lifetime const lifetime = Lifetime::Static) const
+        {
+            int const result = value.data() ?
+                    sqlite3_bind_blob64(GetAbi(), index, value.data(), value.size(), Destructor(lifetime)) :
+                    sqlite3_bind_zeroblob(GetAbi(), index, 0);
+
+            if(SQLITE_OK != result)
+            {
+                ThrowLastError();
+            }
+        }
+
+        void Bind(int const index, std::nullptr_t) const
+        {
+            if(SQLITE_OK != sqlite3_bind_null(GetAbi(), index))
+            {
+                ThrowLastError();
+            }
+        }
+
+        void Bind(int const index, ZeroBlob const value) const
+        {
+            if(SQLITE_OK != sqlite3_bind_zeroblob64(GetAbi(), index, value.Size))
+            {
+                ThrowLastError();
+            }
+        }
+
+        template <typename C>
+        void Bind(int const index, StoredText<C> const & value) const
+        {
+            if(value) Bind(index, *value);
+            else Bind(index, nullptr);
+        }
+
+        // AUTOMATIC BINDING FEATURE METHODS (courtesy of variatic templates)
+
+        //A "template parameter pack" is a template parameter that accepts zero or more template
+        // arguments (non-types, types, or templates)
+        template <typename ... Values>
+        // we dont know what arguments we are receiving
+        void BindAll(Values && ... values) const
+        {
+            // passing all the uncertain values
+            InternalBind(1, std::forward<Values>(values) ...);
+        }
+
+        template <typename ... Values>
+        void Reset(Values && ... values) const {
+            // in order to reset the sqlite state machine
+            if(SQLITE_OK != sqlite3_reset(GetAbi()))
+            {
+                ThrowLastError();
+            }
+            BindAll(values ...);
+        }
+};
+
+class RowIterator
+{
+        Statement const  * m_statement = nullptr;
+
+    public:
+        // default constructor
+        RowIterator() noexcept = default;
+
+        // copy constructor overloaded
+        RowIterator(Statement const & statement) noexcept
+        {
+            if(statement.Step())
+            {
+                m_statement = &statement;
+            }
+        }
+
+        // increments operator overloaded
+        RowIterator & operator++() noexcept
+        {
+            if(!m_statement->Step())
+            {
+                // if iteration is over
+                m_statement = nullptr;
+            }
+            // if it is not iver then return the self object
+            return *this;
+        }
+
+        // different than operator overloaded
+        bool operator!=(RowIterator const & other) const noexcept
+        {
+            return m_statement != other.m_statement;
+        }
+        // row class is above Statement class
+        Row operator *() const noexcept
+        {
+            return Row(m_statement->GetAbi());
+        }
+};
+
+//NO MEMBER FUNCTION HELPERS
+
+// c++ for auto& e : statement calls begin and end
+inline RowIterator begin(Statement const & statement) noexcept
+{
+    return RowIterator(statement);
+}
+
+inline RowIterator end(Statement const &) noexcept
+{
+    // nullptr?
+    return RowIterator();
+}
+
+
+// a copy of a blob, it binds as the blob it was made from
+struct StoredBlob : std::vector<std::byte>
+{
+    StoredBlob(std::span<std::byte const> const bytes) :
+    std::vector<std::byte>(bytes.begin(), bytes.end())
+    {}
+};
+
+// values bound later, maybe on another thread: text is copied into std::string or
+// std::wstring, C strings into a StoredText and blobs into a StoredBlob, the
+// caller's buffers may be gone by then
+template <typename T>
+using StoredValue = std::conditional_t<
+        std::is_same_v<std::decay_t<T>, char const *> || std::is_same_v<std::decay_t<T>, char *>,
+        StoredText<char>, std::conditional_t<
+        std::is_same_v<std::decay_t<T>, wchar_t const *> || std::is_same_v<std::decay_t<T>, wchar_t *>,
+        StoredText<wchar_t>, std::conditional_t<
+        std::is_convertible_v<T, std::string_view> && !std::is_same_v<std::decay_t<T>, std::nullptr_t>,
+        std::string, std::conditional_t<
+        std::is_convertible_v<T, std::wstring_view> && !std::is_same_v<std::decay_t<T>, std::nullptr_t>,
+        std::wstring, std::conditional_t<std::is_convertible_v<T, std::span<std::byte const>>,
+        StoredBlob, std::decay_t<T>>>>>>;
+
+template <typename ... Values>
+using StoredValues = std::tuple<StoredValue<Values> ...>;
+
+// holds the mutex of a connection for a scope, the same recursive mutex sqlite
+// takes in every call; connections opened with SQLITE_OPEN_NOMUTEX have none
+class DatabaseLock
+{
+        sqlite3_mutex * m_mutex;
+
+    public:
+        explicit DatabaseLock(sqlite3 * const connection) noexcept :
+        m_mutex{sqlite3_db_mutex(connection)}
+        {
+            // does nothing for a null mutex
+            sqlite3_mutex_enter(m_mutex);
+        }
+
+        DatabaseLock(DatabaseLock const &) = delete;
+        DatabaseLock & operator=(DatabaseLock const &) = delete;
+
+        ~DatabaseLock() noexcept
+        {
+            sqlite3_mutex_leave(m_mutex);
+        }
+};
+
+// PREPARED STATEMENT CACHE
+/*
+ * Least recently used statements go first when the cache is full.
+ * Statements borrowed by a CachedStatement stay in the list but can not be
+ * evicted until they are returned.
+ * Any schema change prepared on the connection flushes the whole cache.
+ * The cache is guarded by the mutex of its connection, so threads sharing a
+ * connection opened in the default serialized mode can all use it. The
+ * authorizer is only called by sqlite with that mutex held.
+ * */
+class StatementCache
+{
+        using StatementHandle = Handle<Statement::StatementHandleTraits>;
+
+        struct Entry
+        {
+            std::string Text;
+            // empty while the statement is borrowed
+            StatementHandle Handle;
+            unsigned Generation = 0;
+        };
+
+    public:
+        using Iterator = std::list<Entry>::iterator;
+
+        static constexpr std::size_t DefaultCapacity = 64;
+
+    private:
+        sqlite3 * m_connection = nullptr;
+        // most recently used at the front
+        std::list<Entry> m_entries;
+        // keys point to the text inside each entry
+        std::unordered_map<std::string_view, Iterator> m_index;
+        std::size_t m_capacity = DefaultCapacity;
+        // statements prepared under an older generation are dropped when returned
+        unsigned m_generation = 0;
+        bool m_schemaChanged = false;
+        unsigned long long m_schemaChanges = 0;
+        // rollback to a savepoint undoes changes without firing the rollback hook
+        bool m_savepointRolledBack = false;
+        unsigned long long m_savepointRollbacks = 0;
+        // tables read by the statements being prepared, for the result cache
+        std::vector<std::string> * m_reads = nullptr;
+        // the authorizer of the application, chained after the cache
+        Authorizer m_authorizer = nullptr;
+        void * m_authorizerContext = nullptr;
+        StatementCacheStats m_stats;
+
+        // called by sqlite while preparing any statement in this connection
+        static int Authorize(void * const context, int const action, char const * const first,
+                char const * const second, char const * const database, char const * const trigger) noexcept
+        {
+            auto const cache = static_cast<StatementCache *>(context);
+
+            switch(action)
+            {
+                case SQLITE_READ:
+                    if(cache->m_reads && first &&
+                       std::find(cache->m_reads->begin(), cache->m_reads->end(), first) == cache->m_reads->end())
+                    {
+                        try
+                        {
+                            cache->m_reads->emplace_back(first);
+                        }
+                        catch(...)
+                        {
+                            return SQLITE_DENY;
+                        }
+                    }
+                    break;
+                case SQLITE_CREATE_INDEX: case SQLITE_CREATE_TABLE:
+                case SQLITE_CREATE_TEMP_INDEX: case SQLITE_CREATE_TEMP_TABLE:
+                case SQLITE_CREATE_TEMP_TRIGGER: case SQLITE_CREATE_TEMP_VIEW:
+                case SQLITE_CREATE_TRIGGER: case SQLITE_CREATE_VIEW:
+                case SQLITE_DROP_INDEX: case SQLITE_DROP_TABLE:
+                case SQLITE_DROP_TEMP_INDEX: case SQLITE_DROP_TEMP_TABLE:
+                case SQLITE_DROP_TEMP_TRIGGER: case SQLITE_DROP_TEMP_VIEW:
+                case SQLITE_DROP_TRIGGER: case SQLITE_DROP_VIEW:
+                case SQLITE_ALTER_TABLE: case SQLITE_CREATE_VTABLE:
+                case SQLITE_DROP_VTABLE: case SQLITE_ATTACH: case SQLITE_DETACH:
+                    cache->m_schemaChanged = true;
+                    ++cache->m_schemaChanges;
+                    break;
+                case SQLITE_SAVEPOINT:
+                    if(first && 0 == sqlite3_stricmp(first, "ROLLBACK"))
+                    {
+                        cache->m_savepointRolledBack = true;
+                        ++cache->m_savepointRollbacks;
+                    }
+                    break;
+            }
+            // the cache only listens, denying is left to the application
+            if(!cache->m_authorizer) return SQLITE_OK;
+            return cache->m_authorizer(cache->m_authorizerContext, action, first, second, database, trigger);
+        }
+
+        // evicting idle statements from the back until the cache fits
+        void Trim() noexcept
+        {
+            auto entry = m_entries.end();
+
+            while(m_index.size() > m_capacity && entry != m_entries.begin())
+            {
+                --entry;
+                // borrowed statements can not be evicted
+                if(!entry->Handle) continue;
+
+                m_index.erase(entry->Text);
+                entry = m_entries.erase(entry);
+                ++m_stats.Evictions;
+            }
+        }
+
+    public:
+        explicit StatementCache(sqlite3 * const connection) noexcept :
+        m_connection{connection}
+        {
+            sqlite3_set_authorizer(m_connection, Authorize, this);
+        }
+
+        StatementCache(StatementCache const &) = delete;
+        StatementCache & operator=(StatementCache const &) = delete;
+
+        ~StatementCache() noexcept
+        {
+            sqlite3_set_authorizer(m_connection, nullptr, nullptr);
+        }
+
+        Iterator End() noexcept
+        {
+            return m_entries.end();
+        }
+
+        // ownership of the returned statement goes to the caller until Release,
+        // entry is End() when the statement is not cached at all
+        sqlite3_stmt * Borrow(char const * const text, Iterator & entry)
+        {
+            DatabaseLock const lock(m_connection);
+
+            if(m_schemaChanged)
+            {
+                Flush();
+            }
+
+            auto const found = m_index.find(std::string_view(text));
+
+            if(found != m_index.end() && found->second->Handle)
+            {
+                ++m_stats.Hits;
+                entry = found->second;
+                m_entries.splice(m_entries.begin(), m_entries, entry);
+                return entry->Handle.Detach();
+            }
+
+            ++m_stats.Misses;
+            entry = m_entries.end();
+            m_savepointRolledBack = false;
+
+            StatementHandle statement;
+            if(SQLITE_OK != sqlite3_prepare_v3(m_connection, text, -1,
+                    m_capacity ? SQLITE_PREPARE_PERSISTENT : 0, statement.Set(), nullptr))
+            {
+                throw Exception(m_connection);
+            }
+
+            // schema changes and savepoint rollbacks are never cached, so each run
+            // is counted again; a statement with the same text already borrowed
+            // means this one is a temporary duplicate
+            if(m_schemaChanged || m_savepointRolledBack || m_capacity == 0 || found != m_index.end())
+            {
+                return statement.Detach();
+            }
+
+            m_entries.push_front(Entry{text, StatementHandle(), m_generation});
+            entry = m_entries.begin();
+            m_index.emplace(entry->Text, entry);
+            Trim();
+
+            return statement.Detach();
+        }
+
+        // giving back a borrowed statement
+        void Release(Iterator const entry, sqlite3_stmt * const statement) noexcept
+        {
+            DatabaseLock const lock(m_connection);
+
+            // releasing locks of unfinished queries and values bound with SQLITE_STATIC
+            int const result = sqlite3_reset(statement) & 0xff;
+            sqlite3_clear_bindings(statement);
+
+            if(entry->Generation == m_generation && result != SQLITE_ERROR && result != SQLITE_SCHEMA)
+            {
+                entry->Handle.Reset(statement);
+                Trim();
+                return;
+            }
+
+            // stale or broken, it is not worth keeping
+            if(entry->Generation == m_generation)
+            {
+                m_index.erase(entry->Text);
+                ++m_stats.Evictions;
+            }
+            VERIFY(sqlite3_finalize(statement));
+            m_entries.erase(entry);
+        }
+
+        void SetCapacity(std::size_t const capacity) noexcept
+        {
+            DatabaseLock const lock(m_connection);
+            m_capacity = capacity;
+            Trim();
+        }
+
+        void Flush() noexcept
+        {
+            DatabaseLock const lock(m_connection);
+            m_schemaChanged = false;
+            ++m_generation;
+            m_index.clear();
+
+            for(auto entry = m_entries.begin(); entry != m_entries.end();)
+            {
+                entry = entry->Handle ? m_entries.erase(entry) : std::next(entry);
+            }
+        }
+
+        // schema changes prepared so far, they may not have run yet
+        unsigned long long SchemaChanges() const noexcept
+        {
+            return m_schemaChanges;
+        }
+
+        // rollbacks to a savepoint prepared so far, they may not have run yet
+        unsigned long long SavepointRollbacks() const noexcept
+        {
+            return m_savepointRollbacks;
+        }
+
+        // tables read by statements prepared until it is called again with nullptr
+        void TrackReads(std::vector<std::string> * const reads) noexcept
+        {
+            m_reads = reads;
+        }
+
+        void SetAuthorizer(Authorizer const callback, void * const context) noexcept
+        {
+            DatabaseLock const lock(m_connection);
+            m_authorizer = callback;
+            m_authorizerContext = context;
+        }
+
+        StatementCacheStats Stats() const noexcept
+        {
+            DatabaseLock const lock(m_connection);
+            StatementCacheStats stats = m_stats;
+            stats.Size = m_index.size();
+            stats.Capacity = m_capacity;
+            return stats;
+        }
+};
+
+// a statement borrowed from the cache of its connection
+class CachedStatement : public Statement
+{
+        StatementCache * m_cache = nullptr;
+        StatementCache::Iterator m_entry;
+
+    public:
+        CachedStatement(StatementCache & cache, char const * const text)
+        {
+            m_handle.Reset(cache.Borrow(text, m_entry));
+
+            if(m_entry != cache.End())
+            {
+                m_cache = &cache;
+            }
+        }
+
+        CachedStatement(CachedStatement && other) noexcept :
+        Statement(static_cast<Statement &&>(other)),
+        m_cache{other.m_cache},
+        m_entry{other.m_entry}
+        {
+            other.m_cache = nullptr;
+        }
+
+        ~CachedStatement() noexcept
+        {
+            // uncached statements are finalized by Statement as usual
+            if(m_cache && m_handle)
+            {
+                m_cache->Release(m_entry, m_handle.Detach());
+            }
+        }
+};
+
+// RESULT CACHE
+// columns that point into sqlite memory can not outlive the row they were read from
+template <typename T>
+struct BorrowedColumn : std::false_type
+{};
+
+template <>
+struct BorrowedColumn<std::string_view> : std::true_type
+{};
+
+template <>
+struct BorrowedColumn<std::span<std::byte const>> : std::true_type
+{};
+
+template <typename T>
+struct BorrowedColumn<std::optional<T>> : BorrowedColumn<T>
+{};
+
+template <typename Columns>
+struct BorrowedColumns;
+
+template <typename ... Values>
+struct BorrowedColumns<std::tuple<Values ...>> : std::disjunction<BorrowedColumn<Values> ...>
+{};
+
+/*
+ * Results are found by a hash of the text, the row type and the values bound.
+ * Every table counts its changes, reported by the update hook, and a result is
+ * stale once a table it read has counted more. Tables read by a query are
+ * recorded by the authorizer of the statement cache the first time it is prepared,
+ * a query with no tables recorded is stale after any change at all.
+ * Anything the hook can not see drops every result: a rollback, a schema
+ * change, changes the update hook misses (WITHOUT ROWID tables, truncating
+ * deletes) noticed as a difference with sqlite3_total_changes, and commits of
+ * other connections noticed by pragma data_version on the main database.
+ * */
+class ResultCache
+{
+        struct Entry
+        {
+            std::string Key;
+            std::shared_ptr<void const> Rows;
+            std::size_t Bytes = 0;
+            unsigned long long Generation = 0;
+            // the counters of the tables read and their values when the rows were read
+            std::vector<std::pair<unsigned long long const *, unsigned long long>> Versions;
+        };
+
+        // an address for every row type, part of the key
+        template <typename T>
+        static inline char const RowTag = 0;
+
+        sqlite3 * m_connection = nullptr;
+        StatementCache & m_statements;
+        ResultCacheOptions m_options;
+
+        // most recently used at the front
+        std::list<Entry> m_entries;
+        // keys point to the key inside each entry
+        std::unordered_map<std::string_view, std::list<Entry>::iterator> m_index;
+        std::size_t m_bytes = 0;
+        ResultCacheStats m_stats;
+
+        // changes counted for every table read by a cached query, the nodes never move
+        std::unordered_map<std::string, unsigned long long> m_versions;
+        // counters of the tables read by each query text
+        std::unordered_map<std::string, std::vector<unsigned long long *>> m_reads;
+        // the last table changed, bulk changes to one table skip the hash
+        std::string m_lastTable;
+        unsigned long long * m_lastVersion = nullptr;
+        // every change reported, for queries whose tables are not known
+        unsigned long long m_changes = 0;
+
+        // bumped when every result becomes stale
+        unsigned long long m_generation = 0;
+        unsigned long long m_schemaChanges = 0;
+        unsigned long long m_savepointRollbacks = 0;
+        long long m_totalChanges = 0;
+        // update hook calls since m_totalChanges was read
+        long long m_hooked = 0;
+        std::optional<long long> m_dataVersion;
+        std::chrono::steady_clock::time_point m_watched;
+
+        static void Update(void * const context, int, char const *, char const * const table, sqlite3_int64) noexcept
         {
-            // zero is not valid in sql index
-            // binding inside logic
-            if(SQLITE_OK != sqlite3_bind_int(GetAbi(), index, value))
+            auto const cache = static_cast<ResultCache *>(context);
+            ++cache->m_hooked;
+            ++cache->m_changes;
+
+            if(cache->m_lastTable != table)
             {
-                ThrowLastError();
+                auto const found = cache->m_versions.find(table);
+                // tables read by no cached query are not counted
+                if(found == cache->m_versions.end()) return;
+
+                cache->m_lastVersion = &found->second;
+                try
+                {
+                    cache->m_lastTable = table;
+                }
+                catch(...)
+                {
+                    cache->m_lastTable.clear();
+                    ++found->second;
+                    return;
+                }
             }
+            if(cache->m_lastVersion) ++*cache->m_lastVersion;
         }
 
-        // double binding
-        void Bind(int const index, double const value) const
+        static void Rollback(void * const context) noexcept
         {
-            // zero is not valid in sql index
-            // binding inside logic
-            if(SQLITE_OK != sqlite3_bind_double(GetAbi(), index, value))
-            {
-                ThrowLastError();
-            }
+            // changes that were counted are gone again, the results read in between are wrong
+            ++static_cast<ResultCache *>(context)->m_generation;
         }
 
-        void Bind(int const index, float const value) const
+        static long long TotalChanges(sqlite3 * const connection) noexcept
         {
-            Bind(index, static_cast<double>(value));
+#if SQLITE_VERSION_NUMBER >= 3037000
+            return sqlite3_total_changes64(connection);
+#else
+            return sqlite3_total_changes(connection);
+#endif
         }
 
-        // characters
-        //-1 sqlite binds all character as default
-        void Bind(int const index, char const * const value, int const size = -1) const
+        void Erase(std::list<Entry>::iterator const entry) noexcept
         {
-            if(SQLITE_OK != sqlite3_bind_text(GetAbi(), index, value, size, SQLITE_STATIC))
-            {
-                // in case binding is not completed
-                ThrowLastError();
-            }
+            m_bytes -= entry->Bytes;
+            m_index.erase(entry->Key);
+            m_entries.erase(entry);
         }
 
-        // wchat_t wide characters
-        void Bind(int const index, wchar_t const * const value, int const size = -1) const
+        void Trim() noexcept
         {
-            // size is in bytes
-            // SQLITE_STATIC?
-            if(SQLITE_OK != sqlite3_bind_text16(GetAbi(), index, value, size, SQLITE_STATIC))
+            while(m_bytes > m_options.MaxBytes && !m_entries.empty())
             {
-                ThrowLastError();
+                Erase(std::prev(m_entries.end()));
+                ++m_stats.Evictions;
             }
         }
 
-        void Bind(int const index, std::string const & value) const
+        // every change the update hook could not report makes all results stale
+        void Check(Connection const & connection);
+
+        std::vector<unsigned long long *> const & Reads(Connection const & connection, char const * const text);
+
+        static void AppendKey(std::string & key, void const * const data, std::size_t const size)
         {
-            Bind(index, value.c_str(), value.size());
+            key.append(static_cast<char const *>(data), size);
         }
 
-        void Bind(int const index, std::wstring const & value) const
+        static void AppendSizedKey(std::string & key, char const tag, void const * const data, std::size_t const size)
         {
-            Bind(index, value.c_str(), value.size() * sizeof(wchar_t));
+            key += tag;
+            AppendKey(key, &size, sizeof(size));
+            AppendKey(key, data, size);
         }
 
-        // bindings for avoiding SQLITE_TRANSIENT in Bind chars
-        // Overloading to let sqlite doing a private copy
-        void Bind(int const index, std::string && value) const
+        template <typename Value>
+        static void AppendValue(std::string & key, Value const & value)
         {
-            if(SQLITE_OK != sqlite3_bind_text(GetAbi(),
-                    index, value.c_str(),value.size(), SQLITE_TRANSIENT))
+            using Plain = std::decay_t<Value>;
+
+            if constexpr (std::is_same_v<Plain, std::nullptr_t>)
             {
-                ThrowLastError();
+                key += 'n';
+            }
+            else if constexpr (std::is_arithmetic_v<Plain>)
+            {
+                // 1 and 1.0 bind differently
+                key += std::is_floating_point_v<Plain> ? 'f' : 'i';
+                auto const widened = static_cast<std::conditional_t<std::is_floating_point_v<Plain>, double, long long>>(value);
+                AppendKey(key, &widened, sizeof(widened));
+            }
+            else if constexpr (std::is_convertible_v<Value const &, std::string_view>)
+            {
+                std::string_view const text = value;
+                AppendSizedKey(key, 't', text.data(), text.size());
+            }
+            else if constexpr (std::is_convertible_v<Value const &, std::wstring_view>)
+            {
+                std::wstring_view const text = value;
+                AppendSizedKey(key, 'w', text.data(), text.size() * sizeof(wchar_t));
+            }
+            else if constexpr (std::is_convertible_v<Value const &, std::span<std::byte const>>)
+            {
+                std::span<std::byte const> const blob = value;
+                AppendSizedKey(key, 'b', blob.data(), blob.size());
+            }
+            else if constexpr (std::is_same_v<Plain, ZeroBlob>)
+            {
+                key += 'z';
+                AppendKey(key, &value.Size, sizeof(value.Size));
+            }
+            else
+            {
+                static_assert(!sizeof(Value), "the value can not be part of a result cache key");
             }
         }
 
-        // for std::wstring binding
-        void Bind(int const index, std::wstring && value) const
+    public:
+        ResultCache(sqlite3 * const connection, StatementCache & statements) noexcept :
+        m_connection{connection},
+        m_statements{statements},
+        m_schemaChanges{statements.SchemaChanges()},
+        m_savepointRollbacks{statements.SavepointRollbacks()},
+        m_totalChanges{TotalChanges(connection)}
         {
-            if(SQLITE_OK != sqlite3_bind_text16(GetAbi(),
-                    index, value.c_str(), value.size() * sizeof(wchar_t), SQLITE_TRANSIENT))
-            {
-                ThrowLastError();
-            }
+            sqlite3_update_hook(m_connection, Update, this);
+            sqlite3_rollback_hook(m_connection, Rollback, this);
         }
 
-        // AUTOMATIC BINDING FEATURE METHODS (courtesy of variatic templates)
+        ResultCache(ResultCache const &) = delete;
+        ResultCache & operator=(ResultCache const &) = delete;
 
-        //A "template parameter pack" is a template parameter that accepts zero or more template
-        // arguments (non-types, types, or templates)
-        template <typename ... Values>
-        // we dont know what arguments we are receiving
-        void BindAll(Values && ... values) const
+        ~ResultCache() noexcept
         {
-            // passing all the uncertain values
-            InternalBind(1, std::forward<Values>(values) ...);
+            sqlite3_update_hook(m_connection, nullptr, nullptr);
+            sqlite3_rollback_hook(m_connection, nullptr, nullptr);
         }
 
-        template <typename ... Values>
-        void Reset(Values && ... values) const {
-            // in order to reset the sqlite state machine
-            if(SQLITE_OK != sqlite3_reset(GetAbi()))
-            {
-                ThrowLastError();
-            }
-            BindAll(values ...);
+        template <typename T, typename ... Values>
+        std::shared_ptr<std::vector<T> const> Get(Connection const & connection, char const * const text, Values && ... values);
+
+        void SetOptions(ResultCacheOptions const & options) noexcept
+        {
+            m_options = options;
+            Trim();
+        }
+
+        void Flush() noexcept
+        {
+            m_entries.clear();
+            m_index.clear();
+            m_bytes = 0;
+            m_reads.clear();
+            m_versions.clear();
+            m_lastTable.clear();
+            m_lastVersion = nullptr;
+        }
+
+        ResultCacheStats Stats() const noexcept
+        {
+            ResultCacheStats stats = m_stats;
+            stats.Entries = m_entries.size();
+            stats.Bytes = m_bytes;
+            return stats;
         }
 };
 
-class RowIterator
+// CONNECTION MEMBERS THAT NEED THE STATEMENT CACHE
+inline Connection::Connection(Connection && other) noexcept :
+m_borrowed{std::move(other.m_borrowed)},
+m_handle{std::move(other.m_handle)},
+m_cache{std::move(other.m_cache)},
+m_results{std::move(other.m_results)}
+{}
+
+inline Connection & Connection::operator=(Connection && other) noexcept
 {
-        Statement const  * m_statement = nullptr;
+    if(this != &other)
+    {
+        // statements first, the old handle can not be closed with them alive
+        CloseCache();
+        m_handle = std::move(other.m_handle);
+        // after the old handle is closed
+        m_borrowed = std::move(other.m_borrowed);
+        m_cache = std::move(other.m_cache);
+        m_results = std::move(other.m_results);
+    }
+    return *this;
+}
 
-    public:
-        // default constructor
-        RowIterator() noexcept = default;
+inline Connection::~Connection() noexcept
+{
+    CloseCache();
+}
 
-        // copy constructor overloaded
-        RowIterator(Statement const & statement) noexcept
-        {
-            if(statement.Step())
-            {
-                m_statement = &statement;
-            }
-        }
+inline void Connection::CloseCache() noexcept
+{
+    // the result cache uses the authorizer of the statement cache
+    m_results.reset();
+    m_cache.reset();
+}
 
-        // increments operator overloaded
-        RowIterator & operator++() noexcept
+inline StatementCache & Connection::Cache() const
+{
+    DatabaseLock const lock(GetAbi());
+    if(!m_cache)
+    {
+        m_cache = std::make_unique<StatementCache>(GetAbi());
+    }
+    return *m_cache;
+}
+
+template <typename ... Values>
+CachedStatement Connection::Cached(char const * const text, Values && ... values) const
+{
+    // in case a bad connection
+    assert(*this);
+    CachedStatement statement(Cache(), text);
+
+    // a short argument list would silently bind nulls
+    if(sizeof...(Values) != 0 &&
+       static_cast<int>(sizeof...(Values)) != sqlite3_bind_parameter_count(statement.GetAbi()))
+    {
+        throw Exception(SQLITE_RANGE, "wrong number of values bound to: " + std::string(text));
+    }
+
+    statement.BindAll(std::forward<Values>(values) ...);
+    return statement;
+}
+
+inline void Connection::SetCacheCapacity(std::size_t const capacity) const
+{
+    Cache().SetCapacity(capacity);
+}
+
+inline StatementCacheStats Connection::CacheStats() const noexcept
+{
+    DatabaseLock const lock(GetAbi());
+    if(!m_cache)
+    {
+        StatementCacheStats stats;
+        stats.Capacity = StatementCache::DefaultCapacity;
+        return stats;
+    }
+    return m_cache->Stats();
+}
+
+inline void Connection::FlushCache() const noexcept
+{
+    DatabaseLock const lock(GetAbi());
+    if(m_cache)
+    {
+        m_cache->Flush();
+    }
+}
+
+inline void Connection::SetAuthorizer(Authorizer const callback, void * const context) const
+{
+    // the cache installs its own authorizer when it is created
+    Cache().SetAuthorizer(callback, context);
+}
+
+// CONNECTION MEMBERS THAT NEED THE RESULT CACHE
+inline void ResultCache::Check(Connection const & connection)
+{
+    if(m_schemaChanges != m_statements.SchemaChanges())
+    {
+        // views may read other tables now
+        m_schemaChanges = m_statements.SchemaChanges();
+        Flush();
+    }
+
+    // undone changes are not subtracted from the counters, nothing else shows them
+    if(m_savepointRollbacks != m_statements.SavepointRollbacks())
+    {
+        m_savepointRollbacks = m_statements.SavepointRollbacks();
+        ++m_generation;
+    }
+
+    long long const total = TotalChanges(m_connection);
+    if(total - m_totalChanges != m_hooked)
+    {
+        ++m_generation;
+    }
+    m_totalChanges = total;
+    m_hooked = 0;
+
+    auto const now = std::chrono::steady_clock::now();
+    if(m_options.WatchOtherConnections && (!m_dataVersion || now - m_watched >= m_options.WatchInterval))
+    {
+        m_watched = now;
+        CachedStatement version = connection.Cached("pragma data_version");
+        version.Step();
+        long long const current = version.GetInt64();
+
+        if(m_dataVersion && *m_dataVersion != current) ++m_generation;
+        m_dataVersion = current;
+    }
+}
+
+inline std::vector<unsigned long long *> const & ResultCache::Reads(Connection const & connection, char const * const text)
+{
+    auto found = m_reads.find(text);
+    if(found != m_reads.end()) return found->second;
+
+    std::vector<std::string> tables;
+    m_statements.TrackReads(&tables);
+    try
+    {
+        // a fresh prepare, a cached statement would not call the authorizer again
+        Statement probe(connection, text);
+    }
+    catch(...)
+    {
+        m_statements.TrackReads(nullptr);
+        throw;
+    }
+    m_statements.TrackReads(nullptr);
+
+    std::vector<unsigned long long *> versions;
+    for(std::string & table : tables)
+    {
+        versions.push_back(&m_versions.try_emplace(std::move(table), 0).first->second);
+    }
+    // nothing recorded, another authorizer may have replaced the one of the
+    // statement cache: any change to any table makes the result stale
+    if(versions.empty())
+    {
+        versions.push_back(&m_changes);
+    }
+    // a new counter may be the one of the last table changed
+    m_lastTable.clear();
+    m_lastVersion = nullptr;
+
+    return m_reads.emplace(text, std::move(versions)).first->second;
+}
+
+template <typename T, typename ... Values>
+std::shared_ptr<std::vector<T> const> ResultCache::Get(Connection const & connection, char const * const text, Values && ... values)
+{
+    static_assert(!BorrowedColumns<typename RowTraits<T>::Columns>::value,
+            "cached rows can not keep std::string_view or std::span columns");
+
+    Check(connection);
+
+    std::string key = text;
+    key += '\0';
+    char const * const tag = &RowTag<T>;
+    AppendKey(key, &tag, sizeof(tag));
+    (AppendValue(key, values), ...);
+
+    auto const found = m_index.find(key);
+    if(found != m_index.end())
+    {
+        Entry const & entry = *found->second;
+        bool fresh = entry.Generation == m_generation;
+        for(auto const & [version, value] : entry.Versions)
         {
-            if(!m_statement->Step())
-            {
-                // if iteration is over
-                m_statement = nullptr;
-            }
-            // if it is not iver then return the self object
-            return *this;
+            fresh = fresh && *version == value;
         }
 
-        // different than operator overloaded
-        bool operator!=(RowIterator const & other) const noexcept
+        if(fresh)
         {
-            return m_statement != other.m_statement;
+            ++m_stats.Hits;
+            m_entries.splice(m_entries.begin(), m_entries, found->second);
+            return std::static_pointer_cast<std::vector<T> const>(entry.Rows);
         }
-        // row class is above Statement class
-        Row operator *() const noexcept
+
+        ++m_stats.Invalidations;
+        Erase(found->second);
+    }
+    ++m_stats.Misses;
+
+    Entry entry;
+    entry.Generation = m_generation;
+    for(unsigned long long * const version : Reads(connection, text))
+    {
+        entry.Versions.emplace_back(version, *version);
+    }
+
+    auto rows = std::make_shared<std::vector<T>>();
+    std::size_t bytes = 0;
+    {
+        CachedStatement query = connection.Cached(text, std::forward<Values>(values)...);
+        CheckColumns<T>(query.GetAbi());
+
+        int const columns = sqlite3_column_count(query.GetAbi());
+        while(query.Step())
         {
-            return Row(m_statement->GetAbi());
+            rows->push_back(query.template Read<T>());
+
+            // text and blobs live outside of T, roughly
+            for(int column = 0; column != columns; ++column)
+            {
+                int const type = sqlite3_column_type(query.GetAbi(), column);
+                if(type == SQLITE_TEXT || type == SQLITE_BLOB)
+                {
+                    bytes += static_cast<std::size_t>(sqlite3_column_bytes(query.GetAbi(), column));
+                }
+            }
         }
-};
+    }
+    rows->shrink_to_fit();
+    bytes += rows->capacity() * sizeof(T) + key.size() + sizeof(Entry);
 
-//NO MEMBER FUNCTION HELPERS
+    // a result larger than the whole cache is not kept
+    if(bytes <= m_options.MaxBytes)
+    {
+        entry.Key = std::move(key);
+        entry.Rows = rows;
+        entry.Bytes = bytes;
+
+        m_entries.push_front(std::move(entry));
+        m_index.emplace(m_entries.front().Key, m_entries.begin());
+        m_bytes += bytes;
+        Trim();
+    }
+    return rows;
+}
 
-// c++ for auto& e : statement calls begin and end
-inline RowIterator begin(Statement const & statement) noexcept
+inline ResultCache & Connection::Results() const
 {
-    return RowIterator(statement);
+    DatabaseLock const lock(GetAbi());
+    if(!m_results)
+    {
+        // the statement cache records the tables read
+        m_results = std::make_unique<ResultCache>(GetAbi(), Cache());
+    }
+    return *m_results;
 }
 
-inline RowIterator end(Statement const &) noexcept
+template <typename T, typename ... Values>
+std::shared_ptr<std::vector<T> const> Connection::CachedQuery(char const * const text, Values && ... values) const
 {
-    // nullptr?
-    return RowIterator();
+    assert(*this);
+    // the query runs with the lock held, the rows are counted by the same thread
+    DatabaseLock const lock(GetAbi());
+    return Results().Get<T>(*this, text, std::forward<Values>(values)...);
+}
+
+inline void Connection::SetResultCacheOptions(ResultCacheOptions const & options) const
+{
+    DatabaseLock const lock(GetAbi());
+    Results().SetOptions(options);
+}
+
+inline ResultCacheStats Connection::ResultStats() const noexcept
+{
+    DatabaseLock const lock(GetAbi());
+    return m_results ? m_results->Stats() : ResultCacheStats();
 }
 
+inline void Connection::FlushResults() const noexcept
+{
+    DatabaseLock const lock(GetAbi());
+    if(m_results)
+    {
+        m_results->Flush();
+    }
+}
 
 // To be able to execute queries and binding data inline with Connection creation
-template <typename C, typename ... Values>
-void Execute(Connection const & connection, C const * const text,
+// utf8 queries run through the statement cache of the connection
+template <typename ... Values>
+void Execute(Connection const & connection, char const * const text,
+        Values && ... values)
+{
+    connection.Cached(text, std::forward<Values>(values) ...).Execute();
+}
+
+template <typename ... Values>
+void Execute(Connection const & connection, wchar_t const * const text,
         Values && ... values)
 {
     Statement(connection, text, std::forward<Values>(values) ...).Execute();
 }
 
+// TYPED QUERIES
+/*
+ * for(User user : Query<User>(connection, "select Id, Name from Users"))
+ * The columns are checked against RowTraits<User> once, when the query starts,
+ * every row is then decoded without looking at sqlite types.
+ * */
+template <typename T>
+class Query
+{
+        CachedStatement m_statement;
+
+    public:
+        class Iterator
+        {
+                RowIterator m_row;
+
+            public:
+                Iterator() noexcept = default;
+
+                explicit Iterator(Statement const & statement) :
+                m_row{statement}
+                {}
+
+                Iterator & operator++()
+                {
+                    ++m_row;
+                    return *this;
+                }
+
+                bool operator!=(Iterator const & other) const noexcept
+                {
+                    return m_row != other.m_row;
+                }
+
+                T operator*() const
+                {
+                    return (*m_row).template Read<T>();
+                }
+        };
+
+        template <typename ... Values>
+        Query(Connection const & connection, char const * const text, Values && ... values) :
+        m_statement{connection.Cached(text, std::forward<Values>(values)...)}
+        {
+            CheckColumns<T>(m_statement.GetAbi());
+        }
+
+        Statement const & GetStatement() const noexcept
+        {
+            return m_statement;
+        }
+
+        Iterator begin() const
+        {
+            return Iterator(m_statement);
+        }
+
+        Iterator end() const noexcept
+        {
+            return Iterator();
+        }
+};
+
 static void SaveToDisk(Connection const & source, char const * const filename)
 {
     Connection destination(filename);
     Backup backup(destination, source);
     // executing the save of the data, from source to destination
     backup.Step();
+}
+
+// saving a live database without blocking its writers for more than a slice
+inline void SaveToDisk(Connection const & source, char const * const filename,
+        BackupOptions const & options)
+{
+    Connection destination(filename);
+    IncrementalBackup(destination, source, options);
 }
\ No newline at end of file
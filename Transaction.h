@@ -0,0 +1,273 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "TacoLite.h"
+
+/*
+ * TRANSACTIONS AND SAVEPOINTS
+ * Guards that roll back unless they are committed, so an exception never leaves
+ * a transaction open:
+ *
+ *     Transaction transaction(connection, TransactionMode::Immediate);
+ *     Execute(connection, "update Accounts set Balance = Balance - ? where Id = ?", amount, from);
+ *     Execute(connection, "update Accounts set Balance = Balance + ? where Id = ?", amount, to);
+ *     transaction.Commit();
+ *
+ * Writers waiting on each other are handled by a BusyHandler, which sleeps with
+ * exponential backoff instead of failing with SQLITE_BUSY, and RetryTransaction
+ * runs the whole body again when the busy handler gives up.
+ * */
+
+enum class TransactionMode
+{
+        Deferred,
+        // takes the write lock at begin, a deferred transaction that reads and then
+        // writes can fail with SQLITE_BUSY without the busy handler being called
+        Immediate,
+        Exclusive,
+};
+
+inline bool IsBusy(int const result) noexcept
+{
+    return (result & 0xff) == SQLITE_BUSY || (result & 0xff) == SQLITE_LOCKED;
+}
+
+class Transaction
+{
+        Connection const * m_connection = nullptr;
+
+    public:
+        explicit Transaction(Connection const & connection, TransactionMode const mode = TransactionMode::Deferred)
+        {
+            char const * const begin[] = {"begin deferred", "begin immediate", "begin exclusive"};
+            Execute(connection, begin[static_cast<int>(mode)]);
+            m_connection = &connection;
+        }
+
+        Transaction(Transaction && other) noexcept :
+        m_connection{std::exchange(other.m_connection, nullptr)}
+        {}
+
+        Transaction & operator=(Transaction &&) = delete;
+        Transaction(Transaction const &) = delete;
+        Transaction & operator=(Transaction const &) = delete;
+
+        ~Transaction() noexcept
+        {
+            if(m_connection)
+            {
+                Rollback();
+            }
+        }
+
+        explicit operator bool() const noexcept
+        {
+            return m_connection != nullptr;
+        }
+
+        // a failing commit, such as SQLITE_BUSY, leaves the transaction open and rolled back by the guard
+        void Commit()
+        {
+            Execute(*m_connection, "commit");
+            m_connection = nullptr;
+        }
+
+        void Rollback() noexcept
+        {
+            // errors such as SQLITE_FULL already rolled back the transaction
+            if(!sqlite3_get_autocommit(m_connection->GetAbi()))
+            {
+                sqlite3_exec(m_connection->GetAbi(), "rollback", nullptr, nullptr, nullptr);
+            }
+            m_connection = nullptr;
+        }
+};
+
+// a nested transaction, inside or outside of a Transaction
+class Savepoint
+{
+        Connection const * m_connection = nullptr;
+        std::string m_name;
+
+    public:
+        // savepoints of the same name nest, the innermost one is released first
+        explicit Savepoint(Connection const & connection, std::string const & name = "tacolite") :
+        m_name{QuoteName(name)}
+        {
+            Execute(connection, ("savepoint " + m_name).c_str());
+            m_connection = &connection;
+        }
+
+        Savepoint(Savepoint && other) noexcept :
+        m_connection{std::exchange(other.m_connection, nullptr)},
+        m_name{std::move(other.m_name)}
+        {}
+
+        Savepoint & operator=(Savepoint &&) = delete;
+        Savepoint(Savepoint const &) = delete;
+        Savepoint & operator=(Savepoint const &) = delete;
+
+        ~Savepoint() noexcept
+        {
+            if(m_connection)
+            {
+                Rollback();
+            }
+        }
+
+        // keeps the changes, they are committed with the enclosing transaction
+        void Release()
+        {
+            Execute(*m_connection, ("release " + m_name).c_str());
+            m_connection = nullptr;
+        }
+
+        // undoes the changes since the savepoint and ends it
+        void Rollback() noexcept
+        {
+            if(!sqlite3_get_autocommit(m_connection->GetAbi()))
+            {
+                sqlite3_exec(m_connection->GetAbi(), ("rollback to " + m_name + "; release " + m_name).c_str(),
+                        nullptr, nullptr, nullptr);
+            }
+            m_connection = nullptr;
+        }
+};
+
+// BUSY HANDLING
+struct BackoffOptions
+{
+    std::chrono::microseconds Initial{100};
+    std::chrono::microseconds Max{20000};
+    // the busy handler gives up after waiting this long for one lock
+    std::chrono::milliseconds Timeout{5000};
+    // RetryTransaction runs the body this many times at most
+    unsigned Attempts = 8;
+};
+
+// exponential delays with jitter, so waiting writers do not wake up together
+class Backoff
+{
+        BackoffOptions m_options;
+        std::minstd_rand m_random{std::random_device()()};
+
+    public:
+        explicit Backoff(BackoffOptions const & options = BackoffOptions()) :
+        m_options{options}
+        {}
+
+        BackoffOptions const & Options() const noexcept
+        {
+            return m_options;
+        }
+
+        // between half and all of min(Max, Initial * 2^attempt)
+        std::chrono::microseconds Delay(unsigned const attempt)
+        {
+            auto const initial = static_cast<unsigned long long>(std::max<long long>(m_options.Initial.count(), 1));
+            auto const ceiling = static_cast<unsigned long long>(std::max<long long>(m_options.Max.count(), 1));
+            unsigned long long const delay = std::min(ceiling, initial << std::min(attempt, 30u));
+
+            std::uniform_int_distribution<unsigned long long> jitter(delay / 2, delay);
+            return std::chrono::microseconds(jitter(m_random));
+        }
+};
+
+// installed on a connection for as long as it lives, replaces any busy timeout
+class BusyHandler
+{
+        using Clock = std::chrono::steady_clock;
+
+        Connection const * m_connection = nullptr;
+        Backoff m_backoff;
+        Clock::time_point m_started;
+        unsigned long long m_waits = 0;
+
+        static int Wait(void * const context, int const count) noexcept
+        {
+            auto const handler = static_cast<BusyHandler *>(context);
+            auto const now = Clock::now();
+
+            // count starts again for every lock
+            if(count == 0) handler->m_started = now;
+
+            auto const delay = handler->m_backoff.Delay(static_cast<unsigned>(count));
+            if(now + delay - handler->m_started > handler->m_backoff.Options().Timeout)
+            {
+                // SQLITE_BUSY goes to the caller
+                return 0;
+            }
+
+            ++handler->m_waits;
+            std::this_thread::sleep_for(delay);
+            return 1;
+        }
+
+    public:
+        explicit BusyHandler(Connection const & connection, BackoffOptions const & options = BackoffOptions()) :
+        m_connection{&connection},
+        m_backoff{options}
+        {
+            if(SQLITE_OK != sqlite3_busy_handler(connection.GetAbi(), Wait, this))
+            {
+                connection.ThrowLastError();
+            }
+        }
+
+        BusyHandler(BusyHandler const &) = delete;
+        BusyHandler & operator=(BusyHandler const &) = delete;
+
+        ~BusyHandler() noexcept
+        {
+            sqlite3_busy_handler(m_connection->GetAbi(), nullptr, nullptr);
+        }
+
+        // sleeps so far
+        unsigned long long Waits() const noexcept
+        {
+            return m_waits;
+        }
+};
+
+// body() inside a transaction committed at the end, run again from the start while it
+// fails with SQLITE_BUSY or SQLITE_LOCKED, so it must be safe to repeat;
+// its result is returned
+template <typename F>
+auto RetryTransaction(Connection const & connection, F body, TransactionMode const mode = TransactionMode::Immediate,
+        BackoffOptions const & options = BackoffOptions())
+{
+    Backoff backoff(options);
+
+    for(unsigned attempt = 0; ; ++attempt)
+    {
+        try
+        {
+            Transaction transaction(connection, mode);
+
+            if constexpr (std::is_void_v<std::invoke_result_t<F &>>)
+            {
+                body();
+                transaction.Commit();
+                return;
+            }
+            else
+            {
+                auto result = body();
+                transaction.Commit();
+                return result;
+            }
+        }
+        catch(Exception const & e)
+        {
+            if(!IsBusy(e.Result) || attempt + 1 >= options.Attempts) throw;
+        }
+        std::this_thread::sleep_for(backoff.Delay(attempt));
+    }
+}
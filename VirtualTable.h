@@ -0,0 +1,515 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "TacoLite.h"
+
+/*
+ * C++ RANGES AS SQL TABLES
+ * A read only virtual table over rows living in memory, nothing is copied:
+ *
+ *     std::vector<Thing> things = ...;   // sorted by Id
+ *
+ *     TableColumns<Thing> columns;
+ *     columns.Key("Id", &Thing::Id)
+ *            .Column("Name", &Thing::Name)
+ *            .Column("Heavy", [](Thing const & thing) { return thing.Weight > 10; });
+ *     CreateRangeTable(connection, "Things", things, std::move(columns));
+ *
+ *     select Name from Things join Orders using (Id) where Id between 10 and 20
+ *
+ * Equality and range constraints on the key are a binary search, so the rows
+ * must be sorted by it. The rows must outlive the connection and must not move,
+ * text and blobs are handed to sqlite without a copy.
+ * */
+
+// declared type of a column
+template <typename V>
+struct SqlType
+{
+    static constexpr char const * Name = std::is_integral_v<V> ? "INTEGER" :
+            std::is_floating_point_v<V> ? "REAL" :
+            std::is_same_v<V, std::span<std::byte const>> ? "BLOB" : "TEXT";
+};
+
+template <typename V>
+struct SqlType<std::optional<V>> : SqlType<V>
+{
+};
+
+template <typename T>
+class TableColumns
+{
+    public:
+        struct Definition
+        {
+            std::string Name;
+            char const * Type;
+            // sets the value of the column for a row as the result of the context
+            std::function<void(sqlite3_context *, T const &)> Result;
+        };
+
+        // narrows [begin, end) to the rows matching one constraint on the key,
+        // false when the value can not be compared with the key
+        using Search = std::function<bool(std::span<T const>, unsigned char op, sqlite3_value *,
+                std::size_t & begin, std::size_t & end)>;
+
+    private:
+        std::vector<Definition> m_columns;
+        int m_key = -1;
+        bool m_textKey = false;
+        Search m_search;
+
+        // text and blobs pointing into the rows need no copy
+        template <typename V>
+        static void SetColumn(sqlite3_context * const context, V && value) noexcept
+        {
+            using Value = std::decay_t<V>;
+
+            if constexpr (std::is_lvalue_reference_v<V> && std::is_same_v<Value, std::string>)
+            {
+                sqlite3_result_text64(context, value.c_str(), value.size(), SQLITE_STATIC, SQLITE_UTF8);
+            }
+            else if constexpr (std::is_same_v<Value, std::string_view>)
+            {
+                sqlite3_result_text64(context, value.data() ? value.data() : "", value.size(), SQLITE_STATIC, SQLITE_UTF8);
+            }
+            else if constexpr (std::is_same_v<Value, std::span<std::byte const>>)
+            {
+                if(value.data()) sqlite3_result_blob64(context, value.data(), value.size(), SQLITE_STATIC);
+                else sqlite3_result_zeroblob(context, 0);
+            }
+            else if constexpr (std::is_lvalue_reference_v<V> && std::is_same_v<Value, std::optional<std::string>>)
+            {
+                if(value) SetColumn<std::string const &>(context, *value);
+                else sqlite3_result_null(context);
+            }
+            else
+            {
+                // numbers and temporaries are copied
+                SetResult(context, value);
+            }
+        }
+
+        template <typename Key, typename Value>
+        static void Narrow(std::span<T const> const rows, unsigned char const op, Key key, Value const value,
+                std::size_t & begin, std::size_t & end)
+        {
+            auto const lower = [&]
+            {
+                return static_cast<std::size_t>(std::partition_point(rows.begin(), rows.end(),
+                        [&](T const & row) { return key(row) < value; }) - rows.begin());
+            };
+            auto const upper = [&]
+            {
+                return static_cast<std::size_t>(std::partition_point(rows.begin(), rows.end(),
+                        [&](T const & row) { return !(value < key(row)); }) - rows.begin());
+            };
+
+            switch(op)
+            {
+                case SQLITE_INDEX_CONSTRAINT_EQ:
+                    begin = std::max(begin, lower());
+                    end = std::min(end, upper());
+                    break;
+                case SQLITE_INDEX_CONSTRAINT_GT:
+                    begin = std::max(begin, upper());
+                    break;
+                case SQLITE_INDEX_CONSTRAINT_GE:
+                    begin = std::max(begin, lower());
+                    break;
+                case SQLITE_INDEX_CONSTRAINT_LT:
+                    end = std::min(end, lower());
+                    break;
+                case SQLITE_INDEX_CONSTRAINT_LE:
+                    end = std::min(end, upper());
+                    break;
+            }
+            if(begin > end) begin = end;
+        }
+
+    public:
+        template <typename Accessor>
+        TableColumns & Column(std::string name, Accessor accessor)
+        {
+            using Value = std::decay_t<std::invoke_result_t<Accessor const &, T const &>>;
+
+            m_columns.push_back(Definition{std::move(name), SqlType<Value>::Name,
+                    [accessor = std::move(accessor)](sqlite3_context * const context, T const & row)
+            {
+                SetColumn<std::invoke_result_t<Accessor const &, T const &>>(context, std::invoke(accessor, row));
+            }});
+            return *this;
+        }
+
+        // the column the rows are sorted by, only one per table
+        template <typename Accessor>
+        TableColumns & Key(std::string name, Accessor accessor)
+        {
+            using Value = std::decay_t<std::invoke_result_t<Accessor const &, T const &>>;
+            static_assert(std::is_arithmetic_v<Value> || std::is_same_v<Value, std::string> ||
+                    std::is_same_v<Value, std::string_view>, "keys are numbers or text");
+
+            if(m_key != -1)
+            {
+                throw Exception(SQLITE_MISUSE, "a range table has one key column");
+            }
+
+            m_key = static_cast<int>(m_columns.size());
+            m_textKey = !std::is_arithmetic_v<Value>;
+
+            m_search = [accessor](std::span<T const> const rows, unsigned char const op, sqlite3_value * const value,
+                    std::size_t & begin, std::size_t & end)
+            {
+                if constexpr (std::is_arithmetic_v<Value>)
+                {
+                    auto const key = [&accessor](T const & row) { return std::invoke(accessor, row); };
+                    int const type = sqlite3_value_numeric_type(value);
+
+                    // integers compare exactly, other numbers as doubles
+                    if(type == SQLITE_INTEGER && std::is_integral_v<Value>)
+                    {
+                        Narrow(rows, op, key, sqlite3_value_int64(value), begin, end);
+                    }
+                    else if(type == SQLITE_INTEGER || type == SQLITE_FLOAT)
+                    {
+                        Narrow(rows, op, [&key](T const & row) { return static_cast<double>(key(row)); },
+                                sqlite3_value_double(value), begin, end);
+                    }
+                    else
+                    {
+                        return false;
+                    }
+                }
+                else
+                {
+                    if(sqlite3_value_type(value) != SQLITE_TEXT) return false;
+
+                    // held as the accessor returns it, text built per row must outlive the comparison
+                    auto const key = [&accessor](T const & row) -> std::invoke_result_t<Accessor const &, T const &>
+                    {
+                        return std::invoke(accessor, row);
+                    };
+                    Narrow(rows, op, key, ValueTraits<std::string_view>::Get(value), begin, end);
+                }
+                return true;
+            };
+
+            return Column(std::move(name), std::move(accessor));
+        }
+
+        std::vector<Definition> const & Definitions() const noexcept
+        {
+            return m_columns;
+        }
+
+        int KeyColumn() const noexcept
+        {
+            return m_key;
+        }
+
+        bool TextKey() const noexcept
+        {
+            return m_textKey;
+        }
+
+        Search const & KeySearch() const noexcept
+        {
+            return m_search;
+        }
+};
+
+// the sqlite3_module callbacks of a range of T
+template <typename T>
+class RangeTableModule
+{
+        struct State
+        {
+            std::span<T const> Rows;
+            TableColumns<T> Columns;
+        };
+
+        struct Table : sqlite3_vtab
+        {
+            State const * Source = nullptr;
+        };
+
+        struct Cursor : sqlite3_vtab_cursor
+        {
+            std::size_t Current = 0;
+            std::size_t End = 0;
+        };
+
+        // constraints passed to xFilter, in argv order
+        static constexpr int MaxConstraints = 4;
+
+        static int Connect(sqlite3 * const connection, void * const aux, int, char const * const *,
+                sqlite3_vtab ** const table, char ** const error) noexcept
+        {
+            auto const state = static_cast<State const *>(aux);
+
+            try
+            {
+                std::string schema = "create table x(";
+                for(auto const & column : state->Columns.Definitions())
+                {
+                    if(schema.back() != '(') schema += ", ";
+                    schema += QuoteName(column.Name);
+                    schema += ' ';
+                    schema += column.Type;
+                }
+                schema += ")";
+
+                int const result = sqlite3_declare_vtab(connection, schema.c_str());
+                if(SQLITE_OK != result) return result;
+
+                auto created = std::make_unique<Table>();
+                created->Source = state;
+                *table = created.release();
+                return SQLITE_OK;
+            }
+            catch(std::bad_alloc const &)
+            {
+                return SQLITE_NOMEM;
+            }
+            catch(...)
+            {
+                *error = sqlite3_mprintf("range table could not be declared");
+                return SQLITE_ERROR;
+            }
+        }
+
+        static int Disconnect(sqlite3_vtab * const table) noexcept
+        {
+            delete static_cast<Table *>(table);
+            return SQLITE_OK;
+        }
+
+        /*
+         * idxNum holds the operator of every constraint used, one byte each,
+         * in the order their values reach xFilter
+         * */
+        static int BestIndex(sqlite3_vtab * const table, sqlite3_index_info * const info) noexcept
+        {
+            TableColumns<T> const & columns = static_cast<Table *>(table)->Source->Columns;
+            double const rows = static_cast<double>(static_cast<Table *>(table)->Source->Rows.size());
+
+            int used = 0;
+            int operators = 0;
+            bool equality = false;
+            bool lower = false;
+            bool upper = false;
+
+            for(int index = 0; index != info->nConstraint && used != MaxConstraints; ++index)
+            {
+                auto const & constraint = info->aConstraint[index];
+                if(!constraint.usable || constraint.iColumn != columns.KeyColumn()) continue;
+
+                unsigned char const op = constraint.op;
+                if(op != SQLITE_INDEX_CONSTRAINT_EQ && op != SQLITE_INDEX_CONSTRAINT_GT &&
+                        op != SQLITE_INDEX_CONSTRAINT_GE && op != SQLITE_INDEX_CONSTRAINT_LT &&
+                        op != SQLITE_INDEX_CONSTRAINT_LE) continue;
+
+                // text keys are sorted with the binary collation only
+                if(columns.TextKey())
+                {
+                    char const * const collation = sqlite3_vtab_collation(info, index);
+                    if(collation && sqlite3_stricmp(collation, "BINARY") != 0) continue;
+                }
+
+                equality |= op == SQLITE_INDEX_CONSTRAINT_EQ;
+                lower |= op == SQLITE_INDEX_CONSTRAINT_GT || op == SQLITE_INDEX_CONSTRAINT_GE;
+                upper |= op == SQLITE_INDEX_CONSTRAINT_LT || op == SQLITE_INDEX_CONSTRAINT_LE;
+
+                operators |= op << (8 * used);
+                // sqlite checks the constraint again, a value of another type is not narrowed
+                info->aConstraintUsage[index].argvIndex = ++used;
+            }
+
+            info->idxNum = operators;
+
+            double const search = std::log2(rows + 1) + 1;
+            if(equality)
+            {
+                info->estimatedRows = 1;
+                info->estimatedCost = search;
+            }
+            else if(lower && upper)
+            {
+                info->estimatedRows = static_cast<sqlite3_int64>(rows / 16) + 1;
+                info->estimatedCost = search + rows / 16;
+            }
+            else if(lower || upper)
+            {
+                info->estimatedRows = static_cast<sqlite3_int64>(rows / 4) + 1;
+                info->estimatedCost = search + rows / 4;
+            }
+            else
+            {
+                info->estimatedRows = static_cast<sqlite3_int64>(rows);
+                info->estimatedCost = rows + 1;
+            }
+
+            // rows already come sorted by a numeric key
+            if(info->nOrderBy == 1 && info->aOrderBy[0].iColumn == columns.KeyColumn() &&
+                    !info->aOrderBy[0].desc && !columns.TextKey())
+            {
+                info->orderByConsumed = 1;
+            }
+            return SQLITE_OK;
+        }
+
+        static int Open(sqlite3_vtab *, sqlite3_vtab_cursor ** const cursor) noexcept
+        {
+            auto const created = new (std::nothrow) Cursor();
+            if(!created) return SQLITE_NOMEM;
+
+            *cursor = created;
+            return SQLITE_OK;
+        }
+
+        static int Close(sqlite3_vtab_cursor * const cursor) noexcept
+        {
+            delete static_cast<Cursor *>(cursor);
+            return SQLITE_OK;
+        }
+
+        static int Filter(sqlite3_vtab_cursor * const base, int const operators, char const *, int const count,
+                sqlite3_value ** const values) noexcept
+        {
+            auto const cursor = static_cast<Cursor *>(base);
+            State const & state = *static_cast<Table *>(base->pVtab)->Source;
+
+            cursor->Current = 0;
+            cursor->End = state.Rows.size();
+
+            try
+            {
+                for(int index = 0; index != count; ++index)
+                {
+                    // null never matches, the search skips values of other types
+                    if(sqlite3_value_type(values[index]) == SQLITE_NULL)
+                    {
+                        cursor->End = cursor->Current;
+                        break;
+                    }
+                    auto const op = static_cast<unsigned char>(operators >> (8 * index));
+                    state.Columns.KeySearch()(state.Rows, op, values[index], cursor->Current, cursor->End);
+                }
+            }
+            catch(std::bad_alloc const &)
+            {
+                return SQLITE_NOMEM;
+            }
+            catch(...)
+            {
+                return SQLITE_ERROR;
+            }
+            return SQLITE_OK;
+        }
+
+        static int Next(sqlite3_vtab_cursor * const cursor) noexcept
+        {
+            ++static_cast<Cursor *>(cursor)->Current;
+            return SQLITE_OK;
+        }
+
+        static int Eof(sqlite3_vtab_cursor * const base) noexcept
+        {
+            auto const cursor = static_cast<Cursor *>(base);
+            return cursor->Current >= cursor->End;
+        }
+
+        static int Column(sqlite3_vtab_cursor * const base, sqlite3_context * const context, int const column) noexcept
+        {
+            auto const cursor = static_cast<Cursor *>(base);
+            State const & state = *static_cast<Table *>(base->pVtab)->Source;
+
+            try
+            {
+                state.Columns.Definitions()[column].Result(context, state.Rows[cursor->Current]);
+            }
+            catch(...)
+            {
+                FunctionDispatch::Fail(context);
+            }
+            return SQLITE_OK;
+        }
+
+        // the position in the range
+        static int RowId(sqlite3_vtab_cursor * const cursor, sqlite3_int64 * const rowid) noexcept
+        {
+            *rowid = static_cast<sqlite3_int64>(static_cast<Cursor *>(cursor)->Current);
+            return SQLITE_OK;
+        }
+
+    public:
+        static sqlite3_module const * Module() noexcept
+        {
+            static sqlite3_module const module = []
+            {
+                sqlite3_module result{};
+                result.iVersion = 1;
+                // no xCreate: an eponymous table named like the module, nothing goes to the schema
+                result.xConnect = Connect;
+                result.xBestIndex = BestIndex;
+                result.xDisconnect = Disconnect;
+                result.xDestroy = Disconnect;
+                result.xOpen = Open;
+                result.xClose = Close;
+                result.xFilter = Filter;
+                result.xNext = Next;
+                result.xEof = Eof;
+                result.xColumn = Column;
+                result.xRowid = RowId;
+                return result;
+            }();
+            return &module;
+        }
+
+        static void Register(Connection const & connection, char const * const name, std::span<T const> const rows,
+                TableColumns<T> columns)
+        {
+            if(columns.Definitions().empty())
+            {
+                throw Exception(SQLITE_MISUSE, std::string("range table ") + name + " has no columns");
+            }
+
+            auto const destroy = [](void * const state) noexcept
+            {
+                delete static_cast<State *>(state);
+            };
+
+            // sqlite owns the state from now on and destroys it, even when this call fails
+            if(SQLITE_OK != sqlite3_create_module_v2(connection.GetAbi(), name, Module(),
+                    new State{rows, std::move(columns)}, destroy))
+            {
+                connection.ThrowLastError();
+            }
+        }
+};
+
+// the rows are shared, not copied, see above
+template <typename T>
+void CreateRangeTable(Connection const & connection, char const * const name, std::span<T const> const rows,
+        TableColumns<T> columns)
+{
+    RangeTableModule<T>::Register(connection, name, rows, std::move(columns));
+}
+
+template <typename T>
+void CreateRangeTable(Connection const & connection, char const * const name, std::vector<T> const & rows,
+        TableColumns<T> columns)
+{
+    RangeTableModule<T>::Register(connection, name, std::span<T const>(rows), std::move(columns));
+}
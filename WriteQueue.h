@@ -0,0 +1,305 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "TacoLite.h"
+
+/*
+ * GROUP COMMIT
+ * Any thread submits writes, a single thread owns the connection and runs
+ * everything that piled up in one transaction:
+ *     begin immediate; savepoint; write 1; release; savepoint; write 2; ...; commit
+ * A failing write only rolls back its own savepoint.
+ * Futures are ready once the transaction holding their write is committed.
+ * */
+
+struct WriteQueueOptions
+{
+    // writes in one transaction at most
+    std::size_t MaxBatch = 1024;
+    // waiting a little after the first write lets more of them join the batch
+    std::chrono::microseconds Linger{0};
+};
+
+struct WriteQueueStats
+{
+    unsigned long long Writes = 0;
+    unsigned long long Commits = 0;
+
+    double WritesPerCommit() const noexcept
+    {
+        return Commits ? static_cast<double>(Writes) / Commits : 0;
+    }
+};
+
+class WriteTask
+{
+    public:
+        virtual ~WriteTask() = default;
+        virtual void Run(Connection const & connection) = 0;
+        // after the transaction is committed
+        virtual void Complete() = 0;
+        virtual void Fail(std::exception_ptr error) = 0;
+};
+
+template <typename R, typename F>
+class WriteTaskOf : public WriteTask
+{
+        using Result = std::conditional_t<std::is_void_v<R>, bool, R>;
+
+        F m_work;
+        std::promise<R> m_promise;
+        std::optional<Result> m_result;
+
+    public:
+        explicit WriteTaskOf(F work) :
+        m_work{std::move(work)}
+        {}
+
+        std::future<R> GetFuture()
+        {
+            return m_promise.get_future();
+        }
+
+        void Run(Connection const & connection) override
+        {
+            if constexpr (std::is_void_v<R>)
+            {
+                m_work(connection);
+                m_result = true;
+            }
+            else
+            {
+                m_result = m_work(connection);
+            }
+        }
+
+        void Complete() override
+        {
+            if constexpr (std::is_void_v<R>)
+            {
+                m_promise.set_value();
+            }
+            else
+            {
+                m_promise.set_value(std::move(*m_result));
+            }
+        }
+
+        void Fail(std::exception_ptr const error) override
+        {
+            m_promise.set_exception(error);
+        }
+};
+
+class WriteQueue
+{
+        Connection m_connection;
+        WriteQueueOptions m_options;
+
+        std::mutex m_mutex;
+        std::condition_variable m_submitted;
+        std::vector<std::unique_ptr<WriteTask>> m_tasks;
+        bool m_stopping = false;
+
+        std::mutex m_statsMutex;
+        WriteQueueStats m_stats;
+
+        std::thread m_thread;
+
+        void RunBatch(std::vector<std::unique_ptr<WriteTask>> & tasks)
+        {
+            std::vector<std::exception_ptr> errors(tasks.size());
+
+            try
+            {
+                Execute(m_connection, "begin immediate");
+
+                for(std::size_t index = 0; index != tasks.size(); ++index)
+                {
+                    Execute(m_connection, "savepoint write_queue");
+                    try
+                    {
+                        tasks[index]->Run(m_connection);
+                    }
+                    catch(...)
+                    {
+                        errors[index] = std::current_exception();
+                        Execute(m_connection, "rollback to write_queue");
+                    }
+                    Execute(m_connection, "release write_queue");
+                }
+
+                Execute(m_connection, "commit");
+            }
+            catch(...)
+            {
+                // the whole batch is lost
+                if(!sqlite3_get_autocommit(m_connection.GetAbi()))
+                {
+                    sqlite3_exec(m_connection.GetAbi(), "rollback", nullptr, nullptr, nullptr);
+                }
+                std::exception_ptr const error = std::current_exception();
+                for(auto & task : tasks)
+                {
+                    task->Fail(error);
+                }
+                return;
+            }
+
+            // counted before any future is ready, a caller reading Stats after get sees this batch
+            {
+                std::lock_guard<std::mutex> lock(m_statsMutex);
+                m_stats.Writes += tasks.size();
+                ++m_stats.Commits;
+            }
+
+            for(std::size_t index = 0; index != tasks.size(); ++index)
+            {
+                if(errors[index])
+                {
+                    tasks[index]->Fail(errors[index]);
+                }
+                else
+                {
+                    tasks[index]->Complete();
+                }
+            }
+        }
+
+        void Drain() noexcept
+        {
+            std::vector<std::unique_ptr<WriteTask>> batch;
+
+            for(;;)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_submitted.wait(lock, [this] { return m_stopping || !m_tasks.empty(); });
+
+                    if(m_tasks.empty()) return;
+
+                    if(m_options.Linger.count() > 0 && !m_stopping && m_tasks.size() < m_options.MaxBatch)
+                    {
+                        m_submitted.wait_for(lock, m_options.Linger, [this]
+                        {
+                            return m_stopping || m_tasks.size() >= m_options.MaxBatch;
+                        });
+                    }
+
+                    if(m_tasks.size() <= m_options.MaxBatch)
+                    {
+                        batch.swap(m_tasks);
+                    }
+                    else
+                    {
+                        auto const last = m_tasks.begin() + static_cast<std::ptrdiff_t>(m_options.MaxBatch);
+                        batch.assign(std::make_move_iterator(m_tasks.begin()), std::make_move_iterator(last));
+                        m_tasks.erase(m_tasks.begin(), last);
+                    }
+                }
+
+                RunBatch(batch);
+                batch.clear();
+            }
+        }
+
+        template <typename R, typename F>
+        std::future<R> Push(F && work)
+        {
+            auto task = std::make_unique<WriteTaskOf<R, std::decay_t<F>>>(std::forward<F>(work));
+            std::future<R> result = task->GetFuture();
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if(m_stopping)
+                {
+                    throw Exception(SQLITE_MISUSE, "write queue is stopping");
+                }
+                m_tasks.push_back(std::move(task));
+            }
+            m_submitted.notify_one();
+            return result;
+        }
+
+    public:
+        // the queue owns the writer, which is only used by its own thread
+        explicit WriteQueue(Connection connection, WriteQueueOptions const & options = WriteQueueOptions()) :
+                m_connection{std::move(connection)},
+                m_options{options}
+        {
+            if(m_options.MaxBatch == 0)
+            {
+                m_options.MaxBatch = 1;
+            }
+            m_thread = std::thread([this] { Drain(); });
+        }
+
+        WriteQueue(WriteQueue const &) = delete;
+        WriteQueue & operator=(WriteQueue const &) = delete;
+
+        // writes already submitted are still committed
+        ~WriteQueue() noexcept
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stopping = true;
+            }
+            m_submitted.notify_one();
+            m_thread.join();
+        }
+
+        // a query and its values, copied until the write runs
+        template <typename ... Values>
+        std::future<void> Submit(char const * const text, Values && ... values)
+        {
+            return Push<void>([text = std::string(text),
+                    values = StoredValues<Values ...>(std::forward<Values>(values)...)]
+                    (Connection const & connection)
+            {
+                std::apply([&](auto const & ... stored)
+                {
+                    Execute(connection, text.c_str(), stored ...);
+                }, values);
+            });
+        }
+
+        // work receives the prepared statement: queue.Submit(text, [](Statement const & s) { ... })
+        template <typename F, typename = std::enable_if_t<std::is_invocable_v<F &, Statement const &>>>
+        auto Submit(char const * const text, F work) -> std::future<std::invoke_result_t<F &, Statement const &>>
+        {
+            using R = std::invoke_result_t<F &, Statement const &>;
+
+            return Push<R>([text = std::string(text), work = std::move(work)](Connection const & connection) mutable
+            {
+                CachedStatement const statement = connection.Cached(text.c_str());
+                return work(static_cast<Statement const &>(statement));
+            });
+        }
+
+        // work receives the connection: queue.Submit([](Connection const & c) { ... })
+        template <typename F, typename = std::enable_if_t<std::is_invocable_v<F &, Connection const &>>>
+        auto Submit(F work) -> std::future<std::invoke_result_t<F &, Connection const &>>
+        {
+            return Push<std::invoke_result_t<F &, Connection const &>>(std::move(work));
+        }
+
+        WriteQueueStats Stats()
+        {
+            std::lock_guard<std::mutex> lock(m_statsMutex);
+            return m_stats;
+        }
+};
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+/*
+ * SMALL BENCHMARK HARNESS
+ * Every benchmark runs a fixed number of operations several times, the
+ * fastest and the median repetition are reported as JSON.
+ * */
+
+struct BenchmarkResult
+{
+    std::string Name;
+    unsigned long long Operations = 0;
+    std::vector<double> Seconds;
+
+    double Best() const
+    {
+        return *std::min_element(Seconds.begin(), Seconds.end());
+    }
+
+    double Median() const
+    {
+        std::vector<double> sorted = Seconds;
+        std::sort(sorted.begin(), sorted.end());
+        return sorted[sorted.size() / 2];
+    }
+};
+
+class BenchmarkSuite
+{
+        std::vector<BenchmarkResult> m_results;
+        unsigned m_repetitions;
+        std::string m_filter;
+
+        static std::string Escape(std::string const & text)
+        {
+            std::string escaped;
+            for(char const c : text)
+            {
+                if(c == '"' || c == '\\') escaped += '\\';
+                escaped += c;
+            }
+            return escaped;
+        }
+
+    public:
+        explicit BenchmarkSuite(unsigned const repetitions, std::string filter = std::string()) :
+        m_repetitions{repetitions ? repetitions : 1},
+        m_filter{std::move(filter)}
+        {}
+
+        // setup runs before every repetition and is not timed, body performs operations
+        void Run(std::string const & name, unsigned long long const operations,
+                std::function<void()> const & setup, std::function<void()> const & body)
+        {
+            if(!m_filter.empty() && name.find(m_filter) == std::string::npos) return;
+
+            BenchmarkResult result;
+            result.Name = name;
+            result.Operations = operations;
+
+            for(unsigned repetition = 0; repetition != m_repetitions; ++repetition)
+            {
+                setup();
+                auto const start = std::chrono::steady_clock::now();
+                body();
+                result.Seconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            }
+
+            std::fprintf(stderr, "%-48s %12.1f ns/op %14.0f op/s\n", name.c_str(),
+                    result.Median() * 1e9 / operations, operations / result.Median());
+            m_results.push_back(std::move(result));
+        }
+
+        void Run(std::string const & name, unsigned long long const operations,
+                std::function<void()> const & body)
+        {
+            Run(name, operations, [] {}, body);
+        }
+
+        void WriteJson(std::FILE * const file, char const * const sqliteVersion) const
+        {
+            std::fprintf(file, "{\n  \"library\": \"TacoLite\",\n  \"sqlite_version\": \"%s\",\n"
+                    "  \"repetitions\": %u,\n  \"benchmarks\": [\n", sqliteVersion, m_repetitions);
+
+            for(std::size_t index = 0; index != m_results.size(); ++index)
+            {
+                BenchmarkResult const & result = m_results[index];
+                std::fprintf(file, "    {\"name\": \"%s\", \"operations\": %llu, \"best_seconds\": %.9f, "
+                        "\"median_seconds\": %.9f, \"ns_per_op\": %.3f, \"ops_per_second\": %.1f}%s\n",
+                        Escape(result.Name).c_str(), result.Operations, result.Best(), result.Median(),
+                        result.Median() * 1e9 / result.Operations, result.Operations / result.Median(),
+                        index + 1 == m_results.size() ? "" : ",");
+            }
+            std::fprintf(file, "  ]\n}\n");
+        }
+};
@@ -0,0 +1,300 @@
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Benchmark.h"
+#include "BatchInserter.h"
+#include "TacoLite.h"
+
+/*
+ * TACOLITE BENCHMARKS
+ * usage: TacoLiteBench [output.json] [--rows N] [--repetitions N] [--filter text]
+ * Results go to the JSON file (stdout by default), a summary goes to stderr.
+ * Every database lives in memory or in a fresh temporary directory.
+ * */
+
+namespace
+{
+    struct Settings
+    {
+        std::string Output;
+        unsigned long long Rows = 100000;
+        unsigned Repetitions = 5;
+        std::string Filter;
+    };
+
+    Settings ParseArguments(int const argc, char ** const argv)
+    {
+        Settings settings;
+        for(int index = 1; index < argc; ++index)
+        {
+            std::string const argument = argv[index];
+
+            if(argument == "--rows" && index + 1 < argc)
+            {
+                settings.Rows = std::strtoull(argv[++index], nullptr, 10);
+            }
+            else if(argument == "--repetitions" && index + 1 < argc)
+            {
+                settings.Repetitions = static_cast<unsigned>(std::strtoul(argv[++index], nullptr, 10));
+            }
+            else if(argument == "--filter" && index + 1 < argc)
+            {
+                settings.Filter = argv[++index];
+            }
+            else
+            {
+                settings.Output = argument;
+            }
+        }
+        return settings;
+    }
+
+    // the same rows in every run
+    void Fill(Connection const & connection, unsigned long long const rows)
+    {
+        Execute(connection, "create table Things (Id integer, Name text, Weight real)");
+        BatchInserter inserter(connection, "Things", {"Id", "Name", "Weight"});
+        std::string name;
+        for(unsigned long long row = 0; row != rows; ++row)
+        {
+            name = "Thing number " + std::to_string(row);
+            inserter.Insert(static_cast<int>(row), name, row * 0.25);
+        }
+    }
+
+    void InsertBenchmarks(BenchmarkSuite & suite, Settings const & settings)
+    {
+        Connection connection;
+        Statement insert;
+
+        auto const setup = [&]
+        {
+            // the statement goes before the connection it belongs to
+            insert = Statement();
+            connection = Connection::Memory();
+            Execute(connection, "create table Things (Content real)");
+            insert.Prepare(connection, "insert into Things values (?)");
+        };
+
+        // every row is its own transaction
+        suite.Run("insert/reset_execute/autocommit", settings.Rows, setup, [&]
+        {
+            for(unsigned long long row = 0; row != settings.Rows; ++row)
+            {
+                insert.Reset(static_cast<int>(row));
+                insert.Execute();
+            }
+        });
+
+        suite.Run("insert/reset_execute/transaction", settings.Rows, setup, [&]
+        {
+            Execute(connection, "begin");
+            for(unsigned long long row = 0; row != settings.Rows; ++row)
+            {
+                insert.Reset(static_cast<int>(row));
+                insert.Execute();
+            }
+            Execute(connection, "commit");
+        });
+
+        suite.Run("insert/batch_inserter", settings.Rows, setup, [&]
+        {
+            BatchInserter inserter(connection, "Things", {"Content"});
+            for(unsigned long long row = 0; row != settings.Rows; ++row)
+            {
+                inserter.Insert(static_cast<int>(row));
+            }
+        });
+
+        // preparing the same text over and over against borrowing it from the cache
+        suite.Run("execute/uncached_statement", settings.Rows, setup, [&]
+        {
+            Execute(connection, "begin");
+            for(unsigned long long row = 0; row != settings.Rows; ++row)
+            {
+                Statement(connection, "insert into Things values (?)", static_cast<int>(row)).Execute();
+            }
+            Execute(connection, "commit");
+        });
+
+        suite.Run("execute/cached_statement", settings.Rows, setup, [&]
+        {
+            Execute(connection, "begin");
+            for(unsigned long long row = 0; row != settings.Rows; ++row)
+            {
+                Execute(connection, "insert into Things values (?)", static_cast<int>(row));
+            }
+            Execute(connection, "commit");
+        });
+    }
+
+    void ScanBenchmarks(BenchmarkSuite & suite, Settings const & settings)
+    {
+        Connection connection = Connection::Memory();
+        Fill(connection, settings.Rows);
+
+        Statement select(connection, "select Id, Name, Weight from Things");
+        volatile long long sink = 0;
+
+        suite.Run("scan/get_int_float_string", settings.Rows, [&] { select.Reset(); }, [&]
+        {
+            long long total = 0;
+            for(Row row : select)
+            {
+                total += row.GetInt(0) + static_cast<long long>(row.GetFloat(2)) + row.GetString(1)[0];
+            }
+            sink = total;
+        });
+
+        suite.Run("scan/get_string_length", settings.Rows, [&] { select.Reset(); }, [&]
+        {
+            long long total = 0;
+            for(Row row : select)
+            {
+                total += row.GetStringLength(1);
+            }
+            sink = total;
+        });
+
+        suite.Run("scan/get_string_view", settings.Rows, [&] { select.Reset(); }, [&]
+        {
+            long long total = 0;
+            for(Row row : select)
+            {
+                total += static_cast<long long>(row.GetStringView(1).size());
+            }
+            sink = total;
+        });
+
+        suite.Run("scan/copy_to_std_string", settings.Rows, [&] { select.Reset(); }, [&]
+        {
+            long long total = 0;
+            for(Row row : select)
+            {
+                total += static_cast<long long>(row.Get<std::string>(1).size());
+            }
+            sink = total;
+        });
+
+        suite.Run("scan/as_tuple", settings.Rows, [&] { select.Reset(); }, [&]
+        {
+            long long total = 0;
+            for(Row row : select)
+            {
+                auto const [id, name, weight] = row.As<long long, std::string_view, double>();
+                total += id + static_cast<long long>(name.size() + weight);
+            }
+            sink = total;
+        });
+
+        suite.Run("scan/get_type", settings.Rows, [&] { select.Reset(); }, [&]
+        {
+            long long total = 0;
+            for(Row row : select)
+            {
+                total += static_cast<long long>(row.GetType(1));
+            }
+            sink = total;
+        });
+    }
+
+    void BindBenchmarks(BenchmarkSuite & suite, Settings const & settings)
+    {
+        Connection connection = Connection::Memory();
+        Statement select(connection, "select ?1, ?2, ?3");
+        std::string const first = "a string long enough to skip small string optimization";
+        std::string const second = "and another one, just as long as the first string";
+
+        // lvalues are bound with SQLITE_STATIC
+        suite.Run("bind_all/lvalue_strings_static", settings.Rows, [&]
+        {
+            for(unsigned long long row = 0; row != settings.Rows; ++row)
+            {
+                select.Reset();
+                select.BindAll(first, second, static_cast<int>(row));
+            }
+        });
+
+        // rvalues are copied by sqlite with SQLITE_TRANSIENT
+        suite.Run("bind_all/rvalue_strings_transient", settings.Rows, [&]
+        {
+            for(unsigned long long row = 0; row != settings.Rows; ++row)
+            {
+                select.Reset();
+                select.BindAll(std::string(first), std::string(second), static_cast<int>(row));
+            }
+        });
+
+        suite.Run("bind_all/string_view_static", settings.Rows, [&]
+        {
+            for(unsigned long long row = 0; row != settings.Rows; ++row)
+            {
+                select.Reset();
+                select.BindAll(std::string_view(first), std::string_view(second), static_cast<int>(row));
+            }
+        });
+    }
+
+    void BackupBenchmarks(BenchmarkSuite & suite, Settings const & settings)
+    {
+        std::filesystem::path const directory = std::filesystem::temp_directory_path() /
+                ("TacoLiteBench-" + std::to_string(std::random_device()()));
+        std::filesystem::create_directories(directory);
+        std::string const filename = (directory / "backup.db").string();
+
+        Connection connection = Connection::Memory();
+        Fill(connection, settings.Rows);
+
+        auto const clean = [&] { std::filesystem::remove(filename); };
+
+        suite.Run("backup/save_to_disk", settings.Rows, clean, [&]
+        {
+            SaveToDisk(connection, filename.c_str());
+        });
+
+        suite.Run("backup/save_to_disk_incremental", settings.Rows, clean, [&]
+        {
+            BackupOptions options;
+            options.Pause = std::chrono::milliseconds(0);
+            SaveToDisk(connection, filename.c_str(), options);
+        });
+
+        std::filesystem::remove_all(directory);
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    Settings const settings = ParseArguments(argc, argv);
+    BenchmarkSuite suite(settings.Repetitions, settings.Filter);
+
+    try
+    {
+        InsertBenchmarks(suite, settings);
+        ScanBenchmarks(suite, settings);
+        BindBenchmarks(suite, settings);
+        BackupBenchmarks(suite, settings);
+    }
+    catch(Exception const & e)
+    {
+        std::fprintf(stderr, "Error: %s => %d\n", e.Message.c_str(), e.Result);
+        return 1;
+    }
+
+    std::FILE * const output = settings.Output.empty() ? stdout : std::fopen(settings.Output.c_str(), "w");
+    if(!output)
+    {
+        std::fprintf(stderr, "Error: can not write %s\n", settings.Output.c_str());
+        return 1;
+    }
+    suite.WriteJson(output, sqlite3_libversion());
+    if(output != stdout)
+    {
+        std::fclose(output);
+    }
+    return 0;
+}
@@ -1,3 +1,4 @@
+#include <filesystem>
 #include <iostream>
 #include <vector>
 
@@ -55,7 +56,8 @@ int main() {
         Execute(connection, "vacuum");
 
         // creating a backup if a in memory database
-        SaveToDisk(connection,"/home/cheetos/Developer/CProgramming/TacoLite/backup.db");
+        std::string const backup = (std::filesystem::temp_directory_path() / "backup.db").string();
+        SaveToDisk(connection, backup.c_str());
 
         Statement count(connection, "select count(*) from Things");
         // executing the statement
@@ -0,0 +1,107 @@
+#include <string>
+
+#include "ChangeCapture.h"
+#include "Check.h"
+
+/*
+ * CHANGE CAPTURE TESTS
+ * Built with -DTACOLITE_SESSION=ON, see CMakeLists.txt.
+ * */
+
+namespace
+{
+    std::string Names(Connection const & connection)
+    {
+        std::string names;
+        for(Row row : Statement(connection, "select Name from Users order by Id"))
+        {
+            names += row.GetString();
+            names += ' ';
+        }
+        return names;
+    }
+
+    void CreateUsers(Connection const & connection)
+    {
+        Execute(connection, "create table Users (Id integer primary key, Name text)");
+        Execute(connection, "insert into Users values (1, 'a'), (2, 'b')");
+    }
+
+    // committed changes reach the replica, rolled back ones do not
+    void Replicate()
+    {
+        Connection primary = Connection::Memory();
+        Connection replica = Connection::Memory();
+        CreateUsers(primary);
+        CreateUsers(replica);
+
+        ChangeCapture capture(primary);
+        CHECK(capture.Empty());
+
+        Execute(primary, "update Users set Name = 'B' where Id = 2");
+        Execute(primary, "insert into Users values (3, 'c')");
+
+        Execute(primary, "begin");
+        Execute(primary, "delete from Users where Id = 1");
+        bool thrown = false;
+        try
+        {
+            capture.Take();
+        }
+        catch(Exception const & e)
+        {
+            thrown = e.Result == SQLITE_MISUSE;
+        }
+        CHECK(thrown);
+        Execute(primary, "rollback");
+
+        Changeset const changes = capture.Take();
+        CHECK(changes);
+        CHECK(capture.Empty());
+
+        ApplyChangeset(replica, changes.Bytes());
+        CHECK(Names(replica) == "a B c ");
+        CHECK(!capture.Take());
+    }
+
+    // a row changed on both sides
+    void Conflicts()
+    {
+        Connection primary = Connection::Memory();
+        Connection replica = Connection::Memory();
+        CreateUsers(primary);
+        CreateUsers(replica);
+
+        ChangeCapture capture(primary, {"Users"});
+        Execute(primary, "update Users set Name = 'x' where Id = 1");
+        Execute(primary, "update Users set Name = 'y' where Id = 2");
+        Execute(replica, "update Users set Name = 'local' where Id = 2");
+        Changeset const changes = capture.Take();
+
+        bool thrown = false;
+        try
+        {
+            ApplyChangeset(replica, changes.Bytes());
+        }
+        catch(Exception const & e)
+        {
+            thrown = e.Result == SQLITE_ABORT;
+        }
+        CHECK(thrown);
+        // all or nothing
+        CHECK(Names(replica) == "a local ");
+
+        ApplyChangeset(replica, changes.Bytes(), ConflictPolicy::Omit);
+        CHECK(Names(replica) == "x local ");
+
+        ApplyChangeset(replica, changes.Bytes(), ConflictPolicy::Replace);
+        CHECK(Names(replica) == "x y ");
+    }
+}
+
+int main()
+{
+    Replicate();
+    Conflicts();
+    return 0;
+}
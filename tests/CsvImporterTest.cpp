@@ -0,0 +1,44 @@
+#include <string>
+
+#include "Check.h"
+#include "CsvImporter.h"
+
+/*
+ * CSV IMPORTER TESTS
+ * Run under AddressSanitizer to catch fields read after their buffer moved.
+ * */
+
+namespace
+{
+    // several fields with escaped quotes in one row, each kept in its own buffer until the row is inserted
+    void EscapedFields()
+    {
+        Connection connection = Connection::Memory();
+        Execute(connection, "create table T (A, B, C, D)");
+
+        CsvOptions options;
+        options.Header = false;
+        CsvImporter(connection, "T", options).Import(
+                "\"a\"\"b\",\"c\"\"d\",\"e\"\"\"\"f\",\"\"\"\"\n"
+                "plain,\"x\"\"y\",\"z\",\"\"\"w\"\n");
+
+        Statement rows(connection, "select A, B, C, D from T order by rowid");
+        CHECK(rows.Step());
+        CHECK(std::string(rows.GetString(0)) == "a\"b");
+        CHECK(std::string(rows.GetString(1)) == "c\"d");
+        CHECK(std::string(rows.GetString(2)) == "e\"\"f");
+        CHECK(std::string(rows.GetString(3)) == "\"");
+        CHECK(rows.Step());
+        CHECK(std::string(rows.GetString(0)) == "plain");
+        CHECK(std::string(rows.GetString(1)) == "x\"y");
+        CHECK(std::string(rows.GetString(2)) == "z");
+        CHECK(std::string(rows.GetString(3)) == "\"w");
+        CHECK(!rows.Step());
+    }
+}
+
+int main()
+{
+    EscapedFields();
+    return 0;
+}
@@ -0,0 +1,70 @@
+#include <stdexcept>
+
+#include "Check.h"
+#include "Transaction.h"
+
+/*
+ * RESULT CACHE TESTS
+ * Results read inside a savepoint must not outlive its rollback.
+ * */
+
+namespace
+{
+    long long Value(Connection const & connection)
+    {
+        auto const rows = connection.CachedQuery<long long>("select V from T");
+        CHECK(rows->size() == 1);
+        return rows->front();
+    }
+
+    // rollback to does not fire the rollback hook nor lower the total changes
+    void RollbackToSavepoint()
+    {
+        Connection connection = Connection::Memory();
+        Execute(connection, "create table T (V)");
+        Execute(connection, "insert into T values (10)");
+        CHECK(Value(connection) == 10);
+
+        Execute(connection, "savepoint s");
+        Execute(connection, "update T set V = 20");
+        CHECK(Value(connection) == 20);
+        Execute(connection, "rollback to s");
+        Execute(connection, "release s");
+        CHECK(Value(connection) == 10);
+
+        // the statement is counted again every time it runs
+        Execute(connection, "savepoint s");
+        Execute(connection, "update T set V = 20");
+        CHECK(Value(connection) == 20);
+        Execute(connection, "rollback to s");
+        Execute(connection, "release s");
+        CHECK(Value(connection) == 10);
+    }
+
+    // a Savepoint guard unwinding rolls back the same way
+    void SavepointGuard()
+    {
+        Connection connection = Connection::Memory();
+        Execute(connection, "create table T (V)");
+        Execute(connection, "insert into T values (10)");
+
+        try
+        {
+            Savepoint savepoint(connection);
+            Execute(connection, "update T set V = 30");
+            CHECK(Value(connection) == 30);
+            throw std::runtime_error("undone");
+        }
+        catch(std::runtime_error const &)
+        {
+        }
+        CHECK(Value(connection) == 10);
+    }
+}
+
+int main()
+{
+    RollbackToSavepoint();
+    SavepointGuard();
+    return 0;
+}